@@ -0,0 +1,2 @@
+TEMPLATE = subdirs
+SUBDIRS = importbench loadbench membench renderbench seekcheck
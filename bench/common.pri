@@ -0,0 +1,20 @@
+# Settings shared by the benchmark programs.  They are built from the
+# plugin's own sources rather than linking against the plugin.
+
+QT      -= gui
+CONFIG  += console warn_on link_pkgconfig c++11
+CONFIG  -= app_bundle
+
+TEMPLATE = app
+
+INCLUDEPATH += $$PWD $$PWD/..
+DEPENDPATH  += $$PWD $$PWD/..
+
+unix {
+  PKGCONFIG += qmmp libxmp
+
+  QMMP_PREFIX = $$system(pkg-config qmmp --variable=prefix)
+  LOCAL_INCLUDES = $${QMMP_PREFIX}/include
+  LOCAL_INCLUDES -= $$QMAKE_DEFAULT_INCDIRS
+  INCLUDEPATH += $$LOCAL_INCLUDES
+}
@@ -0,0 +1,167 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Measures how playlist import scales with the number of worker threads.
+ *
+ * usage: importbench [-t max_threads] [-r runs] file-or-directory...
+ *
+ * Every file is loaded (with the metadata cache bypassed) once for each
+ * thread count from 1 up to max_threads, doubling each time.  One line
+ * of key=value pairs is printed per thread count.
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+
+#include "moduleinfo.h"
+#include "scanner.h"
+
+static void usage()
+{
+  std::fprintf(stderr, "usage: importbench [-t max_threads] [-r runs] file-or-directory...\n");
+  std::exit(1);
+}
+
+static QStringList expand(const QString &path)
+{
+  QFileInfo file_info(path);
+  QStringList files;
+
+  if(file_info.isDir())
+  {
+    QDir dir(path);
+    for(const QString &name : dir.entryList(QDir::Files | QDir::Readable, QDir::Name))
+    {
+      files << dir.filePath(name);
+    }
+  }
+  else
+  {
+    files << path;
+  }
+
+  return files;
+}
+
+int main(int argc, char **argv)
+{
+  int max_threads = QThread::idealThreadCount();
+  int runs = 3;
+  QStringList files;
+
+  for(int i = 1; i < argc; i++)
+  {
+    if(std::strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+    {
+      max_threads = std::atoi(argv[++i]);
+    }
+    else if(std::strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+    {
+      runs = std::atoi(argv[++i]);
+    }
+    else if(argv[i][0] == '-')
+    {
+      usage();
+    }
+    else
+    {
+      files << expand(QString::fromLocal8Bit(argv[i]));
+    }
+  }
+
+  if(files.isEmpty() || max_threads < 1 || runs < 1)
+  {
+    usage();
+  }
+
+  /* Warm the page cache so the first thread count isn't penalized. */
+  {
+    ModuleScanner scanner(max_threads, false);
+    scanner.scan(files);
+    scanner.wait();
+  }
+
+  QList<int> thread_counts;
+  for(int threads = 1; threads < max_threads; threads *= 2)
+  {
+    thread_counts << threads;
+  }
+  thread_counts << max_threads;
+
+  double baseline = 0;
+
+  for(int threads : thread_counts)
+  {
+    double best = -1;
+    double best_first = 0;
+    int invalid = 0;
+
+    for(int run = 0; run < runs; run++)
+    {
+      ModuleScanner scanner(threads, false);
+      QElapsedTimer timer;
+      std::atomic<int> bad(0);
+      std::atomic<qint64> first(-1);
+
+      timer.start();
+      scanner.scan(files, [&](const QString &, const ModuleInfo *info) {
+        qint64 unset = -1;
+        first.compare_exchange_strong(unset, timer.nsecsElapsed());
+        if(info == nullptr) bad++;
+      });
+      scanner.wait();
+
+      double seconds = timer.nsecsElapsed() / 1e9;
+      if(best < 0 || seconds < best)
+      {
+        best = seconds;
+        best_first = first.load() / 1e6;
+      }
+      invalid = bad.load();
+    }
+
+    if(threads == 1)
+    {
+      baseline = best;
+    }
+
+    std::printf("threads=%d files=%d invalid=%d seconds=%.6f files_per_second=%.2f first_result_ms=%.3f speedup=%.2f\n",
+                threads, files.size(), invalid, best, files.size() / best, best_first, baseline / best);
+    std::fflush(stdout);
+  }
+
+  return 0;
+}
@@ -0,0 +1,10 @@
+include(../common.pri)
+
+TARGET   = importbench
+SOURCES += importbench.cpp \
+           ../../contextpool.cpp \
+           ../../loudness.cpp \
+           ../../metadatacache.cpp \
+           ../../modulecache.cpp \
+           ../../scanner.cpp \
+           ../../xmpwrap.cpp
@@ -0,0 +1,234 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Measures how the cost of opening a module grows with its size, to find
+ * anything that scales worse than linearly.
+ *
+ * usage: loadbench [-r runs] [-o directory]
+ *
+ * Synthetic MOD, XM, S3M and IT files (see synthmodule.h) are written to
+ * a temporary directory, or to the given one, where they are kept.  For
+ * each format, one dimension at a time (patterns, channels, samples,
+ * sample length, order list length) is grown from a small base module,
+ * and for each file the following are timed, in microseconds:
+ *
+ *   can_play:     XMPWrap::can_play()
+ *   probe:        XMPWrap::probe(), the metadata-only playlist path
+ *   load:         constructing an XMPWrap, as the decoder does
+ *   info:         XMPWrap::info(), on top of load
+ *   model:        constructing an XMPMetaDataModel with nothing cached
+ *   model_cached: the same, with the module information cached
+ *
+ * The fastest of the runs is reported, except for model (one run, since
+ * it fills the cache).  load_growth is how much faster than the
+ * dimension the load time grew since the previous step: around 1 is
+ * linear, and well over 1 is worth a look.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QIODevice>
+#include <QString>
+#include <QTemporaryDir>
+
+#include <qmmp/qmmp.h>
+
+#include "metadatamodel.h"
+#include "modulecache.h"
+#include "moduleinfo.h"
+#include "synthmodule.h"
+#include "xmpwrap.h"
+
+namespace
+{
+  struct Dimension
+  {
+    const char *name;
+    std::vector<int> steps;
+    std::function<void(SynthModule &, int)> apply;
+  };
+}
+
+static void usage()
+{
+  std::fprintf(stderr, "usage: loadbench [-r runs] [-o directory]\n");
+  std::exit(1);
+}
+
+static double time_us(int runs, const std::function<void()> &f)
+{
+  double best = -1;
+
+  for(int run = 0; run < runs; run++)
+  {
+    QElapsedTimer timer;
+
+    timer.start();
+    f();
+    double us = timer.nsecsElapsed() / 1e3;
+
+    if(best < 0 || us < best)
+    {
+      best = us;
+    }
+  }
+
+  return best;
+}
+
+static bool write_file(const QString &filename, const std::vector<unsigned char> &data)
+{
+  QFile file(filename);
+
+  return file.open(QIODevice::WriteOnly) &&
+         file.write(reinterpret_cast<const char *>(data.data()), data.size()) == qint64(data.size());
+}
+
+int main(int argc, char **argv)
+{
+  int runs = 5;
+  QString directory;
+
+  for(int i = 1; i < argc; i++)
+  {
+    if(std::strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+    {
+      runs = std::atoi(argv[++i]);
+    }
+    else if(std::strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+    {
+      directory = QString::fromLocal8Bit(argv[++i]);
+    }
+    else
+    {
+      usage();
+    }
+  }
+
+  if(runs < 1)
+  {
+    usage();
+  }
+
+  QTemporaryDir temporary;
+  if(directory.isEmpty())
+  {
+    if(!temporary.isValid())
+    {
+      std::fprintf(stderr, "loadbench: can't create a temporary directory\n");
+      return 1;
+    }
+    directory = temporary.path();
+  }
+  else if(!QDir().mkpath(directory))
+  {
+    std::fprintf(stderr, "loadbench: can't create %s\n", directory.toLocal8Bit().constData());
+    return 1;
+  }
+
+  /* Keep the metadata cache away from the user's, and the module cache
+   * out of the load times.
+   */
+  Qmmp::setConfigDir(directory);
+  ModuleCache::instance().set_budget(0);
+
+  const SynthModule::Format formats[] = { SynthModule::mod, SynthModule::xm, SynthModule::s3m, SynthModule::it };
+  const std::vector<Dimension> dimensions = {
+    { "patterns", { 4, 8, 16, 32, 64, 128, 256 }, [](SynthModule &s, int n) { s.patterns = n; } },
+    { "channels", { 4, 8, 16, 32, 64 }, [](SynthModule &s, int n) { s.channels = n; } },
+    { "samples", { 4, 8, 16, 32, 64, 128 }, [](SynthModule &s, int n) { s.samples = n; } },
+    { "sample_length", { 1 << 10, 1 << 12, 1 << 14, 1 << 16, 1 << 18, 1 << 20, 1 << 22 }, [](SynthModule &s, int n) { s.sample_length = n; } },
+    { "orders", { 8, 16, 32, 64, 128, 254 }, [](SynthModule &s, int n) { s.orders = n; } },
+  };
+
+  for(SynthModule::Format format : formats)
+  {
+    for(const Dimension &dimension : dimensions)
+    {
+      size_t previous_size = 0;
+      int previous_value = 0;
+      double previous_load = 0;
+
+      for(int value : dimension.steps)
+      {
+        SynthModule synth(8);
+        dimension.apply(synth, value);
+
+        std::vector<unsigned char> data = make_module(format, synth);
+
+        /* The format's limits have been reached. */
+        if(data.size() == previous_size)
+        {
+          break;
+        }
+
+        QString filename = QString("%1/%2-%3.%4").arg(directory).arg(dimension.name).arg(value).arg(format_extension(format));
+        std::string name = filename.toUtf8().constData();
+
+        if(!write_file(filename, data))
+        {
+          std::fprintf(stderr, "loadbench: can't write %s\n", name.c_str());
+          return 1;
+        }
+
+        if(!XMPWrap::can_play(name))
+        {
+          std::printf("format=%s dimension=%s value=%d bytes=%zu invalid=1\n",
+                      format_extension(format), dimension.name, value, data.size());
+          std::fflush(stdout);
+          break;
+        }
+
+        double can_play = time_us(runs, [&] { XMPWrap::can_play(name); });
+        double probe = time_us(runs, [&] { ModuleInfo info; XMPWrap::probe(name, info); });
+        double load = time_us(runs, [&] { XMPWrap xmp(name); });
+        double info = time_us(runs, [&] { XMPWrap xmp(name); xmp.info(); }) - load;
+        double model = time_us(1, [&] { XMPMetaDataModel model(filename); });
+        double model_cached = time_us(runs, [&] { XMPMetaDataModel model(filename); });
+        double growth = previous_load > 0 ? (load / previous_load) / (double(value) / previous_value) : 1;
+
+        std::printf("format=%s dimension=%s value=%d bytes=%zu can_play_us=%.1f probe_us=%.1f load_us=%.1f "
+                    "info_us=%.1f model_us=%.1f model_cached_us=%.1f load_growth=%.2f\n",
+                    format_extension(format), dimension.name, value, data.size(), can_play, probe, load,
+                    info, model, model_cached, growth);
+        std::fflush(stdout);
+
+        previous_size = data.size();
+        previous_value = value;
+        previous_load = load;
+      }
+    }
+  }
+
+  return 0;
+}
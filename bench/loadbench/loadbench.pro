@@ -0,0 +1,17 @@
+include(../common.pri)
+
+QT      += gui
+
+TARGET   = loadbench
+HEADERS += ../synthmodule.h
+SOURCES += loadbench.cpp \
+           ../synthmodule.cpp \
+           ../../contextpool.cpp \
+           ../../decodestats.cpp \
+           ../../governor.cpp \
+           ../../metadatacache.cpp \
+           ../../metadatamodel.cpp \
+           ../../modulecache.cpp \
+           ../../sequenceurl.cpp \
+           ../../settings.cpp \
+           ../../xmpwrap.cpp
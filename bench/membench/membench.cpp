@@ -0,0 +1,130 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Measures the heap used by each open playback handle, as a decoder holds
+ * one, and by the metadata built from it for the playlist and the details
+ * dialog.  Run it on a module with many instruments and samples (255
+ * instruments, say) to see what names and comments cost.
+ *
+ * usage: membench [-n handles] file
+ *
+ * Heap usage is glibc's count of allocated bytes.  The module cache is
+ * disabled so that it doesn't count towards the first handle.  One line
+ * of key=value pairs is printed.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <malloc.h>
+
+#include "modulecache.h"
+#include "moduleinfo.h"
+#include "xmpwrap.h"
+
+static void usage()
+{
+  std::fprintf(stderr, "usage: membench [-n handles] file\n");
+  std::exit(1);
+}
+
+static long long heap_in_use()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  return mallinfo2().uordblks;
+#else
+  return mallinfo().uordblks;
+#endif
+}
+
+int main(int argc, char **argv)
+{
+  int handles = 16;
+  const char *filename = nullptr;
+
+  for(int i = 1; i < argc; i++)
+  {
+    if(std::strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+    {
+      handles = std::atoi(argv[++i]);
+    }
+    else if(argv[i][0] == '-' || filename != nullptr)
+    {
+      usage();
+    }
+    else
+    {
+      filename = argv[i];
+    }
+  }
+
+  if(filename == nullptr || handles < 1)
+  {
+    usage();
+  }
+
+  ModuleCache::instance().set_budget(0);
+
+  std::vector<std::unique_ptr<XMPWrap>> xmps;
+  std::vector<ModuleInfo> infos;
+
+  /* The first handle pays for libxmp's one-time setup, so leave it out. */
+  try
+  {
+    xmps.push_back(std::unique_ptr<XMPWrap>(new XMPWrap(filename)));
+  }
+  catch(const XMPWrap::InvalidFile &)
+  {
+    std::fprintf(stderr, "membench: %s: not a module\n", filename);
+    return 1;
+  }
+
+  long long before = heap_in_use();
+
+  for(int i = 0; i < handles; i++)
+  {
+    xmps.push_back(std::unique_ptr<XMPWrap>(new XMPWrap(filename)));
+  }
+
+  long long opened = heap_in_use();
+
+  for(int i = 1; i <= handles; i++)
+  {
+    infos.push_back(xmps[i]->info());
+  }
+
+  long long described = heap_in_use();
+
+  std::printf("handles=%d instruments=%d samples=%d heap_per_handle=%lld metadata_per_handle=%lld\n",
+              handles, infos[0].instrument_count, infos[0].sample_count,
+              (opened - before) / handles, (described - opened) / handles);
+
+  return 0;
+}
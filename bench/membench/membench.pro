@@ -0,0 +1,7 @@
+include(../common.pri)
+
+TARGET   = membench
+SOURCES += membench.cpp \
+           ../../contextpool.cpp \
+           ../../modulecache.cpp \
+           ../../xmpwrap.cpp
@@ -0,0 +1,214 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Measures how fast modules render through XMPWrap, across interpolators,
+ * channel counts, stereo separations and output formats.
+ *
+ * usage: renderbench [-s seconds] [-r rate]
+ *
+ * The modules are synthetic (see synthmodule.h), so results are
+ * comparable between machines and between libxmp and plugin versions.
+ * Each configuration renders the given number of seconds of audio (or
+ * the whole module, if shorter) as fast as possible.  The first line
+ * describes the run; after that, one line of key=value pairs is printed
+ * per configuration.
+ *
+ * The cost of each libxmp frame (one tick) is measured in CPU cycles
+ * where a cycle counter is available (x86), otherwise in nanoseconds; the
+ * cycle_unit key says which.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#include <xmp.h>
+
+#include <QElapsedTimer>
+
+#include "sampleconvert.h"
+#include "synthmodule.h"
+#include "xmpwrap.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+static const char *cycle_unit = "tsc";
+
+static std::uint64_t cycles()
+{
+  return __rdtsc();
+}
+#else
+static const char *cycle_unit = "ns";
+
+static QElapsedTimer cycle_timer;
+
+static std::uint64_t cycles()
+{
+  if(!cycle_timer.isValid())
+  {
+    cycle_timer.start();
+  }
+
+  return cycle_timer.nsecsElapsed();
+}
+#endif
+
+static void usage()
+{
+  std::fprintf(stderr, "usage: renderbench [-s seconds] [-r rate]\n");
+  std::exit(1);
+}
+
+static std::uint64_t percentile(const std::vector<std::uint64_t> &sorted, int p)
+{
+  if(sorted.empty())
+  {
+    return 0;
+  }
+
+  return sorted[(sorted.size() - 1) * p / 100];
+}
+
+int main(int argc, char **argv)
+{
+  int seconds = 10;
+  int rate = XMPWrap::default_rate();
+
+  for(int i = 1; i < argc; i++)
+  {
+    if(std::strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+    {
+      seconds = std::atoi(argv[++i]);
+    }
+    else if(std::strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+    {
+      rate = std::atoi(argv[++i]);
+    }
+    else
+    {
+      usage();
+    }
+  }
+
+  if(seconds < 1 || !XMPWrap::is_valid_rate(rate))
+  {
+    usage();
+  }
+
+  const int channel_counts[] = { 4, 8, 16, 32 };
+  const int separations[] = { 0, 70, 100 };
+  const char *formats[] = { "s16", "float" };
+
+  /* Stable names for the output, rather than the translated ones from
+   * XMPWrap::get_interpolators().
+   */
+  const struct
+  {
+    int value;
+    const char *name;
+  } interpolators[] = {
+    { XMPWrap::interp_nearest, "nearest" },
+    { XMPWrap::interp_linear, "linear" },
+    { XMPWrap::interp_spline, "spline" },
+  };
+
+  std::printf("libxmp=%s rate=%d seconds=%d cycle_unit=%s\n", xmp_version, rate, seconds, cycle_unit);
+  std::fflush(stdout);
+
+  for(int channels : channel_counts)
+  {
+    std::vector<unsigned char> module = make_mod(SynthModule(channels));
+
+    for(const auto &interpolator : interpolators)
+    {
+      for(int separation : separations)
+      {
+        for(const char *format : formats)
+        {
+          bool to_float = std::strcmp(format, "float") == 0;
+          XMPWrap xmp(XMPWrap::Memory(module.data(), module.size()), -1, rate);
+          long long limit = static_cast<long long>(seconds) * rate;
+          long long frames = 0;
+          std::vector<std::uint64_t> costs;
+          std::vector<float> converted;
+          QElapsedTimer timer;
+
+          xmp.set_interpolator(interpolator.value);
+          xmp.set_stereo_separation(separation);
+
+          timer.start();
+          while(frames < limit)
+          {
+            std::uint64_t start = cycles();
+            XMPWrap::Frame frame = xmp.play_frame();
+
+            if(frame.n == 0)
+            {
+              break;
+            }
+
+            if(to_float)
+            {
+              std::size_t n = frame.n / sizeof(std::int16_t);
+
+              if(converted.size() < n)
+              {
+                converted.resize(n);
+              }
+              s16_to_float(converted.data(), static_cast<const std::int16_t *>(frame.buf), n);
+            }
+
+            costs.push_back(cycles() - start);
+            frames += frame.n / xmp.frame_size();
+          }
+          double elapsed = timer.nsecsElapsed();
+
+          std::sort(costs.begin(), costs.end());
+
+          std::printf("interpolator=%s channels=%d separation=%d format=%s frames=%lld seconds=%.6f "
+                      "realtime_factor=%.2f ns_per_frame=%.3f cycles_p50=%llu cycles_p90=%llu cycles_p99=%llu cycles_max=%llu\n",
+                      interpolator.name, channels, separation, format, frames, elapsed / 1e9,
+                      (static_cast<double>(frames) / rate) / (elapsed / 1e9),
+                      frames > 0 ? elapsed / frames : 0.0,
+                      static_cast<unsigned long long>(percentile(costs, 50)),
+                      static_cast<unsigned long long>(percentile(costs, 90)),
+                      static_cast<unsigned long long>(percentile(costs, 99)),
+                      static_cast<unsigned long long>(costs.empty() ? 0 : costs.back()));
+          std::fflush(stdout);
+        }
+      }
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,10 @@
+include(../common.pri)
+
+TARGET   = renderbench
+HEADERS += ../synthmodule.h
+SOURCES += renderbench.cpp \
+           ../synthmodule.cpp \
+           ../../contextpool.cpp \
+           ../../modulecache.cpp \
+           ../../sampleconvert.cpp \
+           ../../xmpwrap.cpp
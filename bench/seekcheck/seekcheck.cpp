@@ -0,0 +1,183 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Checks seeking past the end of the seek index (where XMPWrap jumps to
+ * the start of the order holding the target) against a straight render
+ * of the same module.
+ *
+ * usage: seekcheck [-r rate]
+ *
+ * For each synthetic format, the module is first rendered from start to
+ * end.  Then, for a handful of targets, a fresh player (whose index is
+ * empty) seeks to the target and renders a stretch of audio, which is
+ * lined up against the straight render to find where it really started.
+ * Notes still sounding from before the jump are cut off by it, so the
+ * audio doesn't match exactly; the offset with the smallest difference
+ * is taken.  One line of key=value pairs is printed per seek, and the
+ * exit status is 1 if any seek landed more than a millisecond out.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <xmp.h>
+
+#include "synthmodule.h"
+#include "xmpwrap.h"
+
+static void usage()
+{
+  std::fprintf(stderr, "usage: seekcheck [-r rate]\n");
+  std::exit(1);
+}
+
+/* Render up to the given number of sample frames (all of them if -1). */
+static std::vector<std::int16_t> render(XMPWrap &xmp, long long frames)
+{
+  std::vector<std::int16_t> samples;
+  std::size_t limit = frames < 0 ? static_cast<std::size_t>(-1) : static_cast<std::size_t>(frames) * xmp.channels();
+
+  while(samples.size() < limit)
+  {
+    XMPWrap::Frame frame = xmp.play_frame();
+
+    if(frame.n == 0)
+    {
+      break;
+    }
+
+    const std::int16_t *buf = static_cast<const std::int16_t *>(frame.buf);
+    samples.insert(samples.end(), buf, buf + frame.n / sizeof(std::int16_t));
+  }
+
+  if(samples.size() > limit)
+  {
+    samples.resize(limit);
+  }
+
+  return samples;
+}
+
+int main(int argc, char **argv)
+{
+  int rate = XMPWrap::default_rate();
+
+  for(int i = 1; i < argc; i++)
+  {
+    if(std::strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+    {
+      rate = std::atoi(argv[++i]);
+    }
+    else
+    {
+      usage();
+    }
+  }
+
+  if(!XMPWrap::is_valid_rate(rate))
+  {
+    usage();
+  }
+
+  const SynthModule::Format formats[] = { SynthModule::mod, SynthModule::xm, SynthModule::s3m, SynthModule::it };
+
+  /* Where to seek, as a proportion of the module's duration; odd values
+   * so that targets fall partway through rows.
+   */
+  const double targets[] = { 0.13, 0.37, 0.52, 0.81, 0.97 };
+
+  /* How far either side of the target to look for a match, and how much
+   * audio to compare: 50ms covers being out by a whole tick at the
+   * slowest common tempos.
+   */
+  const long long search = rate / 20;
+  const long long compare = rate / 10;
+  const long long tolerance = rate / 1000;
+
+  bool ok = true;
+
+  std::printf("libxmp=%s rate=%d tolerance_frames=%lld\n", xmp_version, rate, tolerance);
+  std::fflush(stdout);
+
+  for(SynthModule::Format format : formats)
+  {
+    std::vector<unsigned char> module = make_module(format, SynthModule(8, 8, 8, 1024, 24));
+    XMPWrap::Memory memory(module.data(), module.size());
+    XMPWrap linear(memory, -1, rate);
+    std::vector<std::int16_t> reference = render(linear, -1);
+    long long length = reference.size() / linear.channels();
+
+    for(double proportion : targets)
+    {
+      XMPWrap xmp(memory, -1, rate);
+      int pos = static_cast<int>(xmp.duration() * proportion);
+      long long target = static_cast<long long>(pos) * rate / 1000;
+
+      xmp.seek(pos);
+      std::vector<std::int16_t> seeked = render(xmp, compare);
+      long long n = seeked.size() / xmp.channels();
+
+      long long best_offset = 0;
+      unsigned long long best_difference = static_cast<unsigned long long>(-1);
+
+      for(long long offset = -search; offset <= search; offset++)
+      {
+        long long start = target + offset;
+        unsigned long long difference = 0;
+
+        if(start < 0 || start + n > length)
+        {
+          continue;
+        }
+
+        for(long long i = 0; i < n * xmp.channels() && difference < best_difference; i++)
+        {
+          difference += std::abs(seeked[i] - reference[start * xmp.channels() + i]);
+        }
+
+        if(difference < best_difference)
+        {
+          best_difference = difference;
+          best_offset = offset;
+        }
+      }
+
+      bool landed = n > 0 && best_offset >= -tolerance && best_offset <= tolerance;
+      ok = ok && landed;
+
+      std::printf("format=%s target_ms=%d frames=%lld offset_frames=%lld offset_ms=%.3f mean_difference=%.3f result=%s\n",
+                  format_extension(format), pos, n, best_offset, best_offset * 1000.0 / rate,
+                  n > 0 ? static_cast<double>(best_difference) / (n * xmp.channels()) : 0.0,
+                  landed ? "ok" : "bad");
+      std::fflush(stdout);
+    }
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,9 @@
+include(../common.pri)
+
+TARGET   = seekcheck
+HEADERS += ../synthmodule.h
+SOURCES += seekcheck.cpp \
+           ../synthmodule.cpp \
+           ../../contextpool.cpp \
+           ../../modulecache.cpp \
+           ../../xmpwrap.cpp
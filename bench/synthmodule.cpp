@@ -0,0 +1,662 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "synthmodule.h"
+
+namespace
+{
+  const int rows_per_pattern = 64;
+
+  /* The loop length of each waveform, which must divide every sample
+   * length so loops are seamless.
+   */
+  const int waveform_period = 64;
+
+  /* A linear congruential generator: the standard library's engines are
+   * deterministic too, but their distributions are not across
+   * implementations.
+   */
+  class Random
+  {
+    public:
+      explicit Random(unsigned int seed) : state(seed) { }
+
+      int next(int n)
+      {
+        state = state * 1103515245 + 12345;
+        return (state >> 16) % n;
+      }
+
+    private:
+      unsigned int state;
+  };
+
+  /* A format-neutral pattern cell.  Notes are semitones up from the
+   * lowest C used (there are three octaves); samples count from 1.
+   */
+  struct Event
+  {
+    static const int no_note = -1;
+    enum Effect { none, vibrato, volume_slide };
+
+    int note;
+    int sample;
+    Effect effect;
+  };
+
+  /* A note on most rows, with the odd vibrato or volume slide. */
+  Event next_event(Random &random, int samples)
+  {
+    Event event = { Event::no_note, 0, Event::none };
+
+    if(random.next(4) != 0)
+    {
+      event.sample = random.next(samples) + 1;
+      event.note = random.next(36);
+    }
+
+    switch(random.next(8))
+    {
+      case 0:
+        event.effect = Event::vibrato;
+        break;
+      case 1:
+        event.effect = Event::volume_slide;
+        break;
+    }
+
+    return event;
+  }
+
+  /* The sizes actually used, once clamped to a format's limits. */
+  struct Sizes
+  {
+    Sizes(const SynthModule &synth, int min_channels, int max_channels, int max_patterns, int max_samples, int max_orders) :
+      channels(std::max(min_channels, std::min(synth.channels, max_channels))),
+      patterns(std::max(1, std::min(synth.patterns, max_patterns))),
+      samples(std::max(1, std::min(synth.samples, max_samples))),
+      sample_length(std::max(1, synth.sample_length / waveform_period) * waveform_period),
+      orders(std::max(1, std::min(synth.orders > 0 ? synth.orders : patterns, max_orders)))
+    {
+    }
+
+    unsigned int seed() const
+    {
+      return channels * 1000003u + patterns * 1009u + samples * 101u + orders;
+    }
+
+    int channels;
+    int patterns;
+    int samples;
+    int sample_length;
+    int orders;
+  };
+
+  /* ProTracker periods for C-1 to B-3. */
+  const int periods[] = {
+    856, 808, 762, 720, 678, 640, 604, 570, 538, 508, 480, 453,
+    428, 404, 381, 360, 339, 320, 302, 285, 269, 254, 240, 226,
+    214, 202, 190, 180, 170, 160, 151, 143, 135, 127, 120, 113,
+  };
+
+  void put16be(std::vector<unsigned char> &out, int value)
+  {
+    out.push_back((value >> 8) & 0xff);
+    out.push_back(value & 0xff);
+  }
+
+  void put16le(std::vector<unsigned char> &out, int value)
+  {
+    out.push_back(value & 0xff);
+    out.push_back((value >> 8) & 0xff);
+  }
+
+  void put32le(std::vector<unsigned char> &out, long value)
+  {
+    put16le(out, value & 0xffff);
+    put16le(out, (value >> 16) & 0xffff);
+  }
+
+  void set16le(std::vector<unsigned char> &out, size_t at, int value)
+  {
+    out[at] = value & 0xff;
+    out[at + 1] = (value >> 8) & 0xff;
+  }
+
+  void set32le(std::vector<unsigned char> &out, size_t at, long value)
+  {
+    set16le(out, at, value & 0xffff);
+    set16le(out, at + 2, (value >> 16) & 0xffff);
+  }
+
+  void put_string(std::vector<unsigned char> &out, const char *s, size_t size)
+  {
+    size_t n = std::min(std::strlen(s), size);
+
+    out.insert(out.end(), s, s + n);
+    out.insert(out.end(), size - n, 0);
+  }
+
+  void put_zeros(std::vector<unsigned char> &out, size_t n)
+  {
+    out.insert(out.end(), n, 0);
+  }
+
+  /* S3M and IT locate things by offset, S3M in units of 16 bytes. */
+  void align16(std::vector<unsigned char> &out)
+  {
+    put_zeros(out, (16 - out.size() % 16) % 16);
+  }
+
+  signed char waveform(int sample, int i)
+  {
+    const double pi = 3.14159265358979323846;
+    double phase = static_cast<double>(i % waveform_period) / waveform_period;
+
+    switch(sample % 4)
+    {
+      case 0:
+        return static_cast<signed char>(std::lround(std::sin(2 * pi * phase) * 100));
+      case 1:
+        return static_cast<signed char>(std::lround((phase * 2 - 1) * 100));
+      case 2:
+        return phase < 0.5 ? 100 : -100;
+      default:
+        return static_cast<signed char>((i % waveform_period * 37 + sample * 11) % 200 - 100);
+    }
+  }
+
+  const char *name_of(const char *what, int n)
+  {
+    static char name[32];
+
+    std::snprintf(name, sizeof name, "%s %d", what, n);
+
+    return name;
+  }
+}
+
+std::vector<unsigned char> make_mod(const SynthModule &synth)
+{
+  std::vector<unsigned char> out;
+  Sizes sizes(synth, 4, 32, 64, 31, 128);
+  int channels = sizes.channels & ~1;
+  int sample_length = std::min(sizes.sample_length, 65536 / waveform_period * waveform_period);
+  Random random(sizes.seed());
+
+  put_string(out, name_of("synth mod", channels), 20);
+
+  for(int i = 0; i < 31; i++)
+  {
+    bool used = i < sizes.samples;
+
+    put_string(out, used ? name_of("sample", i + 1) : "", 22);
+    put16be(out, used ? sample_length / 2 : 0);
+    out.push_back(0);                                   /* finetune */
+    out.push_back(used ? 64 : 0);                       /* volume */
+    put16be(out, 0);                                    /* loop start */
+    put16be(out, used ? sample_length / 2 : 1);         /* loop length */
+  }
+
+  out.push_back(sizes.orders);
+  out.push_back(127);
+  for(int i = 0; i < 128; i++)
+  {
+    out.push_back(i < sizes.orders ? i % sizes.patterns : 0);
+  }
+
+  char signature[8];
+  if(channels == 4)
+  {
+    std::snprintf(signature, sizeof signature, "M.K.");
+  }
+  else if(channels < 10)
+  {
+    std::snprintf(signature, sizeof signature, "%dCHN", channels);
+  }
+  else
+  {
+    std::snprintf(signature, sizeof signature, "%dCH", channels);
+  }
+  put_string(out, signature, 4);
+
+  for(int pattern = 0; pattern < sizes.patterns; pattern++)
+  {
+    for(int row = 0; row < rows_per_pattern; row++)
+    {
+      for(int channel = 0; channel < channels; channel++)
+      {
+        Event event = next_event(random, sizes.samples);
+        int period = event.note == Event::no_note ? 0 : periods[event.note];
+        int effect = 0, param = 0;
+
+        if(event.effect == Event::vibrato)
+        {
+          effect = 0x4;
+          param = 0x46;
+        }
+        else if(event.effect == Event::volume_slide)
+        {
+          effect = 0xa;
+          param = 0x02;
+        }
+
+        out.push_back((event.sample & 0xf0) | (period >> 8));
+        out.push_back(period & 0xff);
+        out.push_back(((event.sample & 0x0f) << 4) | effect);
+        out.push_back(param);
+      }
+    }
+  }
+
+  for(int i = 0; i < sizes.samples; i++)
+  {
+    for(int j = 0; j < sample_length; j++)
+    {
+      out.push_back(static_cast<unsigned char>(waveform(i, j)));
+    }
+  }
+
+  return out;
+}
+
+/* Patterns are stored unpacked (five bytes a cell), and each instrument
+ * has a single sample.
+ */
+std::vector<unsigned char> make_xm(const SynthModule &synth)
+{
+  std::vector<unsigned char> out;
+  Sizes sizes(synth, 2, 32, 256, 128, 256);
+  int channels = sizes.channels & ~1;
+  Random random(sizes.seed());
+
+  put_string(out, "Extended Module: ", 17);
+  put_string(out, name_of("synth xm", channels), 20);
+  out.push_back(0x1a);
+  put_string(out, "synthmodule", 20);
+  put16le(out, 0x0104);
+  put32le(out, 276);                                    /* header size */
+  put16le(out, sizes.orders);
+  put16le(out, 0);                                      /* restart */
+  put16le(out, channels);
+  put16le(out, sizes.patterns);
+  put16le(out, sizes.samples);
+  put16le(out, 1);                                      /* linear frequencies */
+  put16le(out, 6);                                      /* speed */
+  put16le(out, 125);                                    /* bpm */
+  for(int i = 0; i < 256; i++)
+  {
+    out.push_back(i < sizes.orders ? i % sizes.patterns : 0);
+  }
+
+  for(int pattern = 0; pattern < sizes.patterns; pattern++)
+  {
+    put32le(out, 9);                                    /* header size */
+    out.push_back(0);                                   /* packing */
+    put16le(out, rows_per_pattern);
+    put16le(out, rows_per_pattern * channels * 5);
+
+    for(int row = 0; row < rows_per_pattern; row++)
+    {
+      for(int channel = 0; channel < channels; channel++)
+      {
+        Event event = next_event(random, sizes.samples);
+
+        out.push_back(event.note == Event::no_note ? 0 : 37 + event.note);
+        out.push_back(event.sample);
+        out.push_back(0);                               /* volume column */
+        out.push_back(event.effect == Event::vibrato ? 0x4 : event.effect == Event::volume_slide ? 0xa : 0);
+        out.push_back(event.effect == Event::vibrato ? 0x46 : event.effect == Event::volume_slide ? 0x02 : 0);
+      }
+    }
+  }
+
+  for(int i = 0; i < sizes.samples; i++)
+  {
+    put32le(out, 263);                                  /* instrument header size */
+    put_string(out, name_of("instrument", i + 1), 22);
+    out.push_back(0);                                   /* type */
+    put16le(out, 1);                                    /* samples */
+    put32le(out, 40);                                   /* sample header size */
+    put_zeros(out, 96);                                 /* keymap: all notes to sample 0 */
+    put_zeros(out, 96);                                 /* envelopes */
+    put_zeros(out, 10);                                 /* envelope settings, disabled */
+    put_zeros(out, 4);                                  /* vibrato */
+    put16le(out, 0);                                    /* fadeout */
+    put_zeros(out, 22);
+
+    put32le(out, sizes.sample_length);
+    put32le(out, 0);                                    /* loop start */
+    put32le(out, sizes.sample_length);                  /* loop length */
+    out.push_back(64);                                  /* volume */
+    out.push_back(0);                                   /* finetune */
+    out.push_back(1);                                   /* forward loop, 8-bit */
+    out.push_back(128);                                 /* panning */
+    out.push_back(0);                                   /* relative note */
+    out.push_back(0);
+    put_string(out, name_of("sample", i + 1), 22);
+
+    signed char previous = 0;
+    for(int j = 0; j < sizes.sample_length; j++)
+    {
+      signed char value = waveform(i, j);
+
+      out.push_back(static_cast<unsigned char>(value - previous));
+      previous = value;
+    }
+  }
+
+  return out;
+}
+
+/* ScreamTracker 3 only has 16 sample channels (the rest are AdLib), and
+ * the samples here are unsigned.
+ */
+std::vector<unsigned char> make_s3m(const SynthModule &synth)
+{
+  std::vector<unsigned char> out;
+  Sizes sizes(synth, 1, 16, 100, 99, 254);
+  Random random(sizes.seed());
+  int order_count = (sizes.orders + 2) & ~1;           /* even, with at least one end marker */
+
+  put_string(out, name_of("synth s3m", sizes.channels), 28);
+  out.push_back(0x1a);
+  out.push_back(16);                                    /* type */
+  put16le(out, 0);
+  put16le(out, order_count);
+  put16le(out, sizes.samples);
+  put16le(out, sizes.patterns);
+  put16le(out, 0);                                      /* flags */
+  put16le(out, 0x1320);                                 /* tracker version */
+  put16le(out, 2);                                      /* unsigned samples */
+  put_string(out, "SCRM", 4);
+  out.push_back(64);                                    /* global volume */
+  out.push_back(6);                                     /* speed */
+  out.push_back(125);                                   /* tempo */
+  out.push_back(0x80 | 48);                             /* stereo, master volume */
+  out.push_back(0);                                     /* ultraclick */
+  out.push_back(0);                                     /* no panning table */
+  put_zeros(out, 10);
+  for(int i = 0; i < 32; i++)
+  {
+    /* Alternate left and right. */
+    out.push_back(i < sizes.channels ? (i % 2) * 8 + i / 2 : 255);
+  }
+
+  for(int i = 0; i < order_count; i++)
+  {
+    out.push_back(i < sizes.orders ? i % sizes.patterns : 255);
+  }
+
+  size_t instrument_pointers = out.size();
+  put_zeros(out, 2 * sizes.samples);
+  size_t pattern_pointers = out.size();
+  put_zeros(out, 2 * sizes.patterns);
+
+  std::vector<size_t> instruments;
+  for(int i = 0; i < sizes.samples; i++)
+  {
+    align16(out);
+    set16le(out, instrument_pointers + 2 * i, out.size() / 16);
+    instruments.push_back(out.size());
+
+    out.push_back(1);                                   /* sample */
+    put_string(out, name_of("smp", i + 1), 12);
+    put_zeros(out, 3);                                  /* sample pointer, filled in below */
+    put32le(out, sizes.sample_length);
+    put32le(out, 0);                                    /* loop start */
+    put32le(out, sizes.sample_length);                  /* loop end */
+    out.push_back(64);                                  /* volume */
+    out.push_back(0);
+    out.push_back(0);                                   /* not packed */
+    out.push_back(1);                                   /* loop */
+    put32le(out, 8363);                                 /* C-4 speed */
+    put_zeros(out, 12);
+    put_string(out, name_of("sample", i + 1), 28);
+    put_string(out, "SCRS", 4);
+  }
+
+  for(int pattern = 0; pattern < sizes.patterns; pattern++)
+  {
+    align16(out);
+    set16le(out, pattern_pointers + 2 * pattern, out.size() / 16);
+
+    size_t start = out.size();
+    put16le(out, 0);
+
+    for(int row = 0; row < rows_per_pattern; row++)
+    {
+      for(int channel = 0; channel < sizes.channels; channel++)
+      {
+        Event event = next_event(random, sizes.samples);
+        int what = channel;
+
+        if(event.note != Event::no_note) what |= 0x20;
+        if(event.effect != Event::none) what |= 0x80;
+
+        if(what == channel)
+        {
+          continue;
+        }
+
+        out.push_back(what);
+        if(what & 0x20)
+        {
+          out.push_back(((4 + event.note / 12) << 4) | (event.note % 12));
+          out.push_back(event.sample);
+        }
+        if(what & 0x80)
+        {
+          out.push_back(event.effect == Event::vibrato ? 8 : 4);       /* H or D */
+          out.push_back(event.effect == Event::vibrato ? 0x46 : 0x02);
+        }
+      }
+      out.push_back(0);
+    }
+
+    set16le(out, start, out.size() - start);
+  }
+
+  for(int i = 0; i < sizes.samples; i++)
+  {
+    align16(out);
+
+    size_t pointer = out.size() / 16;
+    out[instruments[i] + 13] = (pointer >> 16) & 0xff;
+    set16le(out, instruments[i] + 14, pointer & 0xffff);
+
+    for(int j = 0; j < sizes.sample_length; j++)
+    {
+      out.push_back(static_cast<unsigned char>(waveform(i, j) + 128));
+    }
+  }
+
+  return out;
+}
+
+/* Sample mode (no instruments), uncompressed signed samples. */
+std::vector<unsigned char> make_it(const SynthModule &synth)
+{
+  std::vector<unsigned char> out;
+  Sizes sizes(synth, 1, 64, 200, 99, 254);
+  Random random(sizes.seed());
+  int order_count = sizes.orders + 1;                   /* with an end marker */
+
+  put_string(out, "IMPM", 4);
+  put_string(out, name_of("synth it", sizes.channels), 26);
+  put16le(out, 0x1004);                                 /* pattern row highlight */
+  put16le(out, order_count);
+  put16le(out, 0);                                      /* instruments */
+  put16le(out, sizes.samples);
+  put16le(out, sizes.patterns);
+  put16le(out, 0x0214);                                 /* created with */
+  put16le(out, 0x0214);                                 /* compatible with */
+  put16le(out, 0x09);                                   /* stereo, linear slides */
+  put16le(out, 0);                                      /* special */
+  out.push_back(128);                                   /* global volume */
+  out.push_back(48);                                    /* mix volume */
+  out.push_back(6);                                     /* speed */
+  out.push_back(125);                                   /* tempo */
+  out.push_back(128);                                   /* separation */
+  out.push_back(0);
+  put16le(out, 0);                                      /* message length */
+  put32le(out, 0);                                      /* message offset */
+  put32le(out, 0);
+  for(int i = 0; i < 64; i++)
+  {
+    out.push_back(i < sizes.channels ? (i % 2 ? 48 : 16) : 32 | 128);
+  }
+  for(int i = 0; i < 64; i++)
+  {
+    out.push_back(64);
+  }
+
+  for(int i = 0; i < order_count; i++)
+  {
+    out.push_back(i < sizes.orders ? i % sizes.patterns : 255);
+  }
+
+  size_t sample_pointers = out.size();
+  put_zeros(out, 4 * sizes.samples);
+  size_t pattern_pointers = out.size();
+  put_zeros(out, 4 * sizes.patterns);
+
+  std::vector<size_t> samples;
+  for(int i = 0; i < sizes.samples; i++)
+  {
+    set32le(out, sample_pointers + 4 * i, out.size());
+    samples.push_back(out.size());
+
+    put_string(out, "IMPS", 4);
+    put_string(out, name_of("smp", i + 1), 12);
+    out.push_back(0);
+    out.push_back(64);                                  /* global volume */
+    out.push_back(0x11);                                /* present, looped, 8-bit */
+    out.push_back(64);                                  /* volume */
+    put_string(out, name_of("sample", i + 1), 26);
+    out.push_back(1);                                   /* signed */
+    out.push_back(32);                                  /* default pan, unused */
+    put32le(out, sizes.sample_length);
+    put32le(out, 0);                                    /* loop start */
+    put32le(out, sizes.sample_length);                  /* loop end */
+    put32le(out, 8363);                                 /* C-5 speed */
+    put32le(out, 0);                                    /* sustain loop */
+    put32le(out, 0);
+    put32le(out, 0);                                    /* sample pointer, filled in below */
+    put_zeros(out, 4);                                  /* vibrato */
+  }
+
+  for(int pattern = 0; pattern < sizes.patterns; pattern++)
+  {
+    set32le(out, pattern_pointers + 4 * pattern, out.size());
+
+    size_t start = out.size();
+    put16le(out, 0);
+    put16le(out, rows_per_pattern);
+    put_zeros(out, 4);
+
+    for(int row = 0; row < rows_per_pattern; row++)
+    {
+      for(int channel = 0; channel < sizes.channels; channel++)
+      {
+        Event event = next_event(random, sizes.samples);
+        int mask = 0;
+
+        if(event.note != Event::no_note) mask |= 0x03;
+        if(event.effect != Event::none) mask |= 0x08;
+
+        if(mask == 0)
+        {
+          continue;
+        }
+
+        out.push_back((channel + 1) | 0x80);
+        out.push_back(mask);
+        if(mask & 0x03)
+        {
+          out.push_back(48 + event.note);
+          out.push_back(event.sample);
+        }
+        if(mask & 0x08)
+        {
+          out.push_back(event.effect == Event::vibrato ? 8 : 4);       /* H or D */
+          out.push_back(event.effect == Event::vibrato ? 0x46 : 0x02);
+        }
+      }
+      out.push_back(0);
+    }
+
+    set16le(out, start, out.size() - start - 8);
+  }
+
+  for(int i = 0; i < sizes.samples; i++)
+  {
+    set32le(out, samples[i] + 0x48, out.size());
+
+    for(int j = 0; j < sizes.sample_length; j++)
+    {
+      out.push_back(static_cast<unsigned char>(waveform(i, j)));
+    }
+  }
+
+  return out;
+}
+
+std::vector<unsigned char> make_module(SynthModule::Format format, const SynthModule &synth)
+{
+  switch(format)
+  {
+    case SynthModule::xm:
+      return make_xm(synth);
+    case SynthModule::s3m:
+      return make_s3m(synth);
+    case SynthModule::it:
+      return make_it(synth);
+    default:
+      return make_mod(synth);
+  }
+}
+
+const char *format_extension(SynthModule::Format format)
+{
+  switch(format)
+  {
+    case SynthModule::xm:
+      return "xm";
+    case SynthModule::s3m:
+      return "s3m";
+    case SynthModule::it:
+      return "it";
+    default:
+      return "mod";
+  }
+}
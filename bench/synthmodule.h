@@ -0,0 +1,69 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef QMMP_XMP_SYNTHMODULE_H
+#define QMMP_XMP_SYNTHMODULE_H
+
+#include <vector>
+
+/* Small modules made up on the spot, so the benchmarks have something to
+ * work on that is the same everywhere and needs no files.  The content is
+ * not music, but it keeps every channel busy with looped samples, notes
+ * and a few common effects, which is what costs time in the mixer.
+ * Generation is deterministic: the same parameters give the same bytes.
+ *
+ * Sizes are clamped to what each format can hold: for example, a MOD has
+ * at most 31 samples and 64 patterns, and an S3M at most 16 channels.
+ */
+struct SynthModule
+{
+  enum Format { mod, xm, s3m, it };
+
+  SynthModule(int channels, int patterns = 8, int samples = 8, int sample_length = 1024, int orders = 0) :
+    channels(channels), patterns(patterns), samples(samples), sample_length(sample_length), orders(orders) { }
+
+  int channels;
+  int patterns;
+  int samples;
+
+  /* In bytes (all samples are 8-bit). */
+  int sample_length;
+
+  /* The length of the order list, which cycles through the patterns;
+   * 0 means once through each pattern.
+   */
+  int orders;
+};
+
+std::vector<unsigned char> make_mod(const SynthModule &);
+std::vector<unsigned char> make_xm(const SynthModule &);
+std::vector<unsigned char> make_s3m(const SynthModule &);
+std::vector<unsigned char> make_it(const SynthModule &);
+
+std::vector<unsigned char> make_module(SynthModule::Format, const SynthModule &);
+const char *format_extension(SynthModule::Format);
+
+#endif
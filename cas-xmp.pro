@@ -1,6 +1,6 @@
 QT      += widgets
-HEADERS += decoderfactory.h decoder.h metadatamodel.h settingsdialog.h settings.h xmpwrap.h
-SOURCES += decoder.cpp decoderfactory.cpp metadatamodel.cpp settingsdialog.cpp xmpwrap.cpp
+HEADERS += contextpool.h decoderfactory.h decoder.h decodestats.h governor.h loudness.h metadatacache.h metadatamodel.h modulecache.h moduleinfo.h renderahead.h sampleconvert.h scanner.h sequenceurl.h settingsdialog.h settings.h signature.h spscring.h xmpwrap.h
+SOURCES += contextpool.cpp decoder.cpp decoderfactory.cpp decodestats.cpp governor.cpp loudness.cpp metadatacache.cpp metadatamodel.cpp modulecache.cpp renderahead.cpp sampleconvert.cpp scanner.cpp sequenceurl.cpp settings.cpp settingsdialog.cpp signature.cpp xmpwrap.cpp
 FORMS   += settingsdialog.ui
 
 CONFIG += warn_on plugin link_pkgconfig c++11
@@ -0,0 +1,94 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <mutex>
+#include <vector>
+
+#include <xmp.h>
+
+#include "contextpool.h"
+
+namespace
+{
+  std::mutex pool_mutex;
+  std::vector<xmp_context> idle;
+
+  /* The default pan of a new context, for resetting recycled ones. */
+  int initial_defpan = -1;
+}
+
+xmp_context ContextPool::acquire()
+{
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+
+    if(!idle.empty())
+    {
+      xmp_context ctx = idle.back();
+      idle.pop_back();
+      return ctx;
+    }
+  }
+
+  xmp_context ctx = xmp_create_context();
+
+  std::lock_guard<std::mutex> lock(pool_mutex);
+
+  if(initial_defpan == -1)
+  {
+    initial_defpan = xmp_get_player(ctx, XMP_PLAYER_DEFPAN);
+  }
+
+  return ctx;
+}
+
+/* Accepts a context in any state: playing, loaded, or empty. */
+void ContextPool::release(xmp_context ctx)
+{
+  int state = xmp_get_player(ctx, XMP_PLAYER_STATE);
+
+  if(state >= XMP_STATE_PLAYING)
+  {
+    xmp_end_player(ctx);
+  }
+
+  if(state >= XMP_STATE_LOADED)
+  {
+    xmp_release_module(ctx);
+  }
+
+  std::lock_guard<std::mutex> lock(pool_mutex);
+
+  if(static_cast<int>(idle.size()) < max_idle && initial_defpan >= 0)
+  {
+    xmp_set_player(ctx, XMP_PLAYER_DEFPAN, initial_defpan);
+    idle.push_back(ctx);
+  }
+  else
+  {
+    xmp_free_context(ctx);
+  }
+}
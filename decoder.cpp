@@ -24,95 +24,431 @@
  * SUCH DAMAGE.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
 #include <cstring>
+#include <future>
 #include <memory>
+#include <string>
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <QByteArray>
+#include <QFileDevice>
+#include <QIODevice>
+#include <QMap>
 #include <QString>
 #include <QtGlobal>
 
 #include <qmmp/decoder.h>
 
 #include "decoder.h"
+#include "decodestats.h"
+#include "loudness.h"
+#include "metadatacache.h"
+#include "moduleinfo.h"
+#include "sampleconvert.h"
+#include "sequenceurl.h"
 
-XMPDecoder::XMPDecoder(const QString &path)
-        : Decoder(),
+XMPDecoder::XMPDecoder(const QString &path, QIODevice *input)
+        : Decoder(input),
           path(path)
 {
 }
 
+/* Streams may not have everything available up front, so keep reading
+ * (and waiting) until the device runs dry.
+ */
+static QByteArray read_device(QIODevice *device)
+{
+  QByteArray data;
+  char buf[65536];
+
+  while(true)
+  {
+    qint64 n = device->read(buf, sizeof buf);
+
+    if(n > 0)
+    {
+      data.append(buf, n);
+    }
+    else if(n < 0 || !device->waitForReadyRead(5000))
+    {
+      break;
+    }
+  }
+
+  return data;
+}
+
+/* Ask the kernel to start reading the file in now, so that the load
+ * (which maps it) doesn't stall on disk.  This is only a hint.
+ */
+static void readahead(const QString &filename)
+{
+  int fd = open(filename.toUtf8().constData(), O_RDONLY);
+
+  if(fd != -1)
+  {
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+  }
+}
+
+/* The loading of the module (reading, depacking, sample conversion, and
+ * libxmp's scan of every sequence) happens on a thread of its own, so
+ * that initialize() doesn't keep Qmmp waiting at a track change.  All
+ * that initialize() needs is the duration, which is normally in the
+ * metadata cache since the playlist entry was created; only without it
+ * does initialize() wait for the load.
+ */
 bool XMPDecoder::initialize()
 {
-  try
+  int rate;
+  int sequence;
+  QString filename = parse_sequence_url(path, sequence);
+  bool is_file = input() == nullptr || qobject_cast<QFileDevice *>(input()) != nullptr;
+  ModuleInfo info;
+
+  settings = XMPSettings::snapshot(&settings_generation);
+  rate = settings.mixing_rate;
+
+  int panning_amplitude = settings.panning_amplitude;
+  bool collect_stats = settings.collect_stats;
+
+  output_rate = rate;
+
+  /* Local files are mapped by XMPWrap itself, which is cheaper than
+   * reading them through Qmmp's device; anything else is read into
+   * memory (here, since the device belongs to this thread) and loaded
+   * from there.
+   */
+  if(is_file)
   {
-    xmp = std::unique_ptr<XMPWrap>(new XMPWrap(path.toUtf8().constData(), settings.get_panning_amplitude()));
+    std::string name = filename.toUtf8().constData();
+
+    readahead(filename);
+    loading = std::async(std::launch::async, [name, panning_amplitude, rate, sequence, collect_stats] {
+      std::int64_t start = collect_stats ? now() : 0;
+      std::unique_ptr<XMPWrap> xmp(new XMPWrap(name, panning_amplitude, rate, sequence, true));
+
+      if(collect_stats)
+      {
+        DecodeStats::instance().record_load(now() - start);
+      }
+
+      return xmp;
+    });
   }
-  catch(const XMPWrap::InvalidFile &)
+  else
+  {
+    QByteArray data = read_device(input());
+
+    loading = std::async(std::launch::async, [data, panning_amplitude, rate, sequence, collect_stats] {
+      std::int64_t start = collect_stats ? now() : 0;
+      std::unique_ptr<XMPWrap> xmp(new XMPWrap(XMPWrap::Memory(data.constData(), data.size()),
+                                               panning_amplitude, rate, sequence));
+
+      if(collect_stats)
+      {
+        DecodeStats::instance().record_load(now() - start);
+      }
+
+      return xmp;
+    });
+  }
+
+  if(is_file && MetaDataCache::instance().lookup(filename, info) &&
+     sequence >= 0 && sequence < static_cast<int>(info.sequences.size()))
+  {
+    const ModuleInfo::Sequence &cached = info.sequences[sequence];
+
+    duration = cached.duration;
+    channel_count = info.channel_count;
+
+    /* Loudness is only ever known from the cache: measuring it takes a
+     * full render, which is left to background analysis.
+     */
+    if(cached.analyzed && std::isfinite(cached.loudness))
+    {
+      QMap<Qmmp::ReplayGainKey, double> replay_gain;
+
+      replay_gain[Qmmp::REPLAYGAIN_TRACK_GAIN] = LoudnessMeter::replay_gain(cached.loudness);
+      replay_gain[Qmmp::REPLAYGAIN_TRACK_PEAK] = cached.peak;
+      setReplayGainInfo(replay_gain);
+    }
+  }
+  else if(wait_for_load())
+  {
+    duration = xmp->duration();
+    channel_count = xmp->channel_count();
+  }
+  else
   {
     return false;
   }
 
-  configure(xmp->rate(), xmp->channels(), Qmmp::PCM_S16LE);
+  if(settings.output_format == XMPSettings::format_float)
+  {
+    sample_size = sizeof(float);
+    configure(rate, 2, Qmmp::PCM_FLOAT);
+  }
+  else
+  {
+    sample_size = sizeof(std::int16_t);
+    configure(rate, 2, Qmmp::PCM_S16LE);
+  }
 
   return true;
 }
 
+/* Pick up the module from the background load, if that hasn't been done
+ * yet.  A module that fails to load here (after initialize() succeeded
+ * on the strength of the cache) simply plays as silence of no length.
+ */
+bool XMPDecoder::wait_for_load()
+{
+  if(xmp == nullptr && loading.valid())
+  {
+    try
+    {
+      xmp = loading.get();
+    }
+    catch(const XMPWrap::InvalidFile &)
+    {
+      return false;
+    }
+
+    xmp->set_interpolator(settings.interpolator);
+    xmp->set_stereo_separation(settings.stereo_separation);
+    governor.reset(settings.interpolator);
+    xmp->set_muted_channels(settings.muted_channels);
+
+    if(settings.render_ahead)
+    {
+      ahead.reset(new RenderAhead(*xmp, settings, settings.render_ahead_depth * output_rate / 1000));
+    }
+  }
+
+  return xmp != nullptr;
+}
+
 qint64 XMPDecoder::totalTime() const
 {
-  return xmp->duration();
+  return duration;
 }
 
 int XMPDecoder::bitrate() const
 {
-  return xmp->channel_count();
+  return channel_count;
 }
 
+/* For measuring track changes: the time at which the most recent decoder
+ * ran out of audio, or -1.
+ */
+static std::atomic<std::int64_t> track_end_time(-1);
+
+/* Render as many frames as needed to fill the whole buffer: a single
+ * libxmp frame is only one tick of audio, which can be a few hundred
+ * bytes, and returning that little causes Qmmp to call back far more
+ * often than necessary.  A short read only happens at the end of the
+ * module.
+ *
+ * In low-latency mode, each read returns at most one block of the
+ * configured size; whatever is left of a tick waits for the next read.
+ *
+ * When rendering ahead, frames come from the rendering thread (which
+ * also does the timing of frames and the governing), so a read is just
+ * a copy unless that thread has fallen behind.
+ *
+ * With statistics enabled, each read and each libxmp frame is timed;
+ * otherwise the clock isn't touched.
+ */
 qint64 XMPDecoder::read(unsigned char *audio, qint64 max_size)
 {
-  qint64 copied;
+  qint64 copied = 0;
+  std::int64_t read_start = 0;
 
-  xmp->set_interpolator(settings.get_interpolator());
-  xmp->set_stereo_separation(settings.get_stereo_separation());
+  if(!wait_for_load())
+  {
+    return 0;
+  }
 
-  copied = copy(audio, max_size);
-  audio += copied;
-  max_size -= copied;
+  if(XMPSettings::generation() != settings_generation)
+  {
+    apply_settings();
+  }
 
-  if(buf_filled == 0)
+  qint64 size = max_size;
+  if(settings.block_size != 0)
   {
-    XMPWrap::Frame frame = xmp->play_frame();
-    if(frame.n == 0)
+    size = std::min(size, settings.block_size * 2 * sample_size);
+  }
+
+  bool collect_stats = settings.collect_stats;
+  bool govern = settings.governor && !ahead;
+  if(collect_stats || govern)
+  {
+    read_start = now();
+  }
+
+  while(size - copied >= sample_size)
+  {
+    if(buf_filled == 0)
     {
-      return copied;
+      XMPWrap::Frame frame(0, nullptr);
+
+      if(ahead)
+      {
+        frame = ahead->next();
+      }
+      else
+      {
+        std::int64_t frame_start = collect_stats ? now() : 0;
+
+        frame = xmp->play_frame();
+
+        if(collect_stats)
+        {
+          DecodeStats::instance().record_frame(now() - frame_start);
+        }
+      }
+
+      if(frame.n == 0)
+      {
+        break;
+      }
+
+      bufptr = static_cast<const unsigned char *>(frame.buf);
+      buf_filled = frame.n;
+    }
+
+    copied += copy(audio + copied, size - copied);
+  }
+
+  if(collect_stats || govern)
+  {
+    std::int64_t read_ns = now() - read_start;
+    std::int64_t audio_ns = copied / (sample_size * 2) * 1000000000LL / output_rate;
+
+    if(collect_stats)
+    {
+      qint64 buffered = (ahead ? ahead->buffered() : xmp->buffered()) + buf_filled / (2 * sizeof(std::int16_t));
+
+      DecodeStats::instance().record_read(read_ns, copied, size - size % sample_size, audio_ns);
+      DecodeStats::instance().record_buffered(buffered * 1000000000LL / output_rate);
     }
 
-    bufptr = reinterpret_cast<unsigned char *>(frame.buf);
-    buf_filled += frame.n;
+    if(govern && governor.update(read_ns, audio_ns))
+    {
+      xmp->set_interpolator(governor.interpolator());
+    }
   }
 
-  return copied + copy(audio, max_size);
+  if(copied == 0 && !finished)
+  {
+    finished = true;
+    if(collect_stats)
+    {
+      track_end_time = now();
+    }
+  }
+  else if(copied != 0 && !started)
+  {
+    std::int64_t ended = track_end_time.exchange(-1);
+
+    started = true;
+    if(collect_stats && ended != -1)
+    {
+      DecodeStats::instance().record_track_change(now() - ended);
+    }
+  }
+
+  return copied;
+}
+
+/* Called when the settings dialog has published new values.  Only the
+ * settings which actually changed are passed on to the player.  The
+ * panning amplitude is only used when a module is loaded, so a change
+ * will take effect on the next track, as will turning rendering ahead
+ * on or off.  While rendering ahead, the player belongs to the rendering
+ * thread, so changes are passed on to it instead.
+ */
+void XMPDecoder::apply_settings()
+{
+  XMPSettings::Snapshot snapshot = XMPSettings::snapshot(&settings_generation);
+
+  if(ahead)
+  {
+    ahead->apply(snapshot);
+  }
+  else
+  {
+    XMPSettings::apply(settings, snapshot, *xmp, governor);
+  }
+
+  settings = snapshot;
 }
 
+/* libxmp has no interface for mixing into a caller-supplied buffer
+ * (xmp_play_buffer() is a memcpy from the same internal frame buffer), so
+ * this copy (or conversion) is the only one made, other than into a
+ * packet when rendering ahead.  Whatever does not fit is left where
+ * libxmp put it and picked up by the next read(), rather than being
+ * staged in a buffer of our own.
+ *
+ * buf_filled counts bytes of libxmp's 16-bit output, while max_size and
+ * the return value are in bytes of the configured output format.
+ */
 qint64 XMPDecoder::copy(unsigned char *audio, qint64 max_size)
 {
-  qint64 to_copy;
+  qint64 samples;
 
-  to_copy = qMin(buf_filled, max_size);
+  samples = qMin(buf_filled / qint64(sizeof(std::int16_t)), max_size / sample_size);
 
   /* It's safe to copy 0 bytes, but both pointers must still have valid
    * values, and bufptr will be invalid on the first call.
    */
-  if(to_copy != 0)
+  if(samples != 0)
   {
-    std::memcpy(audio, bufptr, to_copy);
+    if(sample_size == sizeof(float))
+    {
+      s16_to_float(reinterpret_cast<float *>(audio), reinterpret_cast<const std::int16_t *>(bufptr), samples);
+    }
+    else
+    {
+      std::memcpy(audio, bufptr, samples * sizeof(std::int16_t));
+    }
   }
 
-  bufptr += to_copy;
-  buf_filled -= to_copy;
+  bufptr += samples * sizeof(std::int16_t);
+  buf_filled -= samples * sizeof(std::int16_t);
 
-  return to_copy;
+  return samples * sample_size;
 }
 
+/* Anything left over from before the seek is stale, so drop it. */
 void XMPDecoder::seek(qint64 pos)
 {
-  xmp->seek(pos);
+  buf_filled = 0;
+  finished = false;
+
+  if(wait_for_load() && ahead)
+  {
+    ahead->seek(pos);
+  }
+  else if(xmp != nullptr)
+  {
+    std::int64_t start = settings.collect_stats ? now() : 0;
+
+    xmp->seek(pos);
+
+    if(settings.collect_stats)
+    {
+      DecodeStats::instance().record_seek(now() - start);
+    }
+  }
 }
@@ -27,20 +27,24 @@
 #ifndef QMMP_XMP_DECODER_H
 #define QMMP_XMP_DECODER_H
 
+#include <future>
 #include <memory>
 
+#include <QIODevice>
 #include <QString>
 #include <QtGlobal>
 
 #include <qmmp/decoder.h>
 
+#include "governor.h"
+#include "renderahead.h"
 #include "settings.h"
 #include "xmpwrap.h"
 
 class XMPDecoder : public Decoder
 {
   public:
-    explicit XMPDecoder(const QString &);
+    XMPDecoder(const QString &, QIODevice *);
 
     bool initialize() override;
     qint64 totalTime() const override;
@@ -50,12 +54,26 @@ class XMPDecoder : public Decoder
 
   private:
     qint64 copy(unsigned char *, qint64);
+    void apply_settings();
+    bool wait_for_load();
 
     QString path;
+    std::future<std::unique_ptr<XMPWrap>> loading;
     std::unique_ptr<XMPWrap> xmp;
+
+    /* Declared after the player, which it uses, so it's destroyed first. */
+    std::unique_ptr<RenderAhead> ahead;
+    qint64 duration = 0;
+    int channel_count = 0;
+    bool started = false;
+    bool finished = false;
     const unsigned char *bufptr = nullptr;
     qint64 buf_filled = 0;
-    XMPSettings settings;
+    qint64 sample_size = 2;
+    int output_rate = 0;
+    RenderGovernor governor;
+    XMPSettings::Snapshot settings;
+    unsigned int settings_generation = 0;
 };
 
 #endif
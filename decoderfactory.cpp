@@ -24,6 +24,8 @@
  * SUCH DAMAGE.
  */
 
+#include <cmath>
+
 #include <QIODevice>
 #include <QList>
 #include <QMessageBox>
@@ -36,13 +38,34 @@
 
 #include "decoderfactory.h"
 #include "decoder.h"
+#include "loudness.h"
+#include "metadatacache.h"
 #include "metadatamodel.h"
+#include "moduleinfo.h"
+#include "scanner.h"
+#include "sequenceurl.h"
+#include "settings.h"
 #include "settingsdialog.h"
+#include "signature.h"
 #include "xmpwrap.h"
 
-bool XMPDecoderFactory::canDecode(QIODevice *) const
+/* Qmmp creates the factory when it loads the plugin, before anything is
+ * loaded through it.
+ */
+XMPDecoderFactory::XMPDecoderFactory()
 {
-  return false;
+  XMPSettings settings;
+
+  settings.apply_cache_size();
+  MetaDataCache::instance().preload();
+}
+
+bool XMPDecoderFactory::canDecode(QIODevice *input) const
+{
+  unsigned char buf[signature_size];
+  qint64 n = input->peek(reinterpret_cast<char *>(buf), sizeof buf);
+
+  return n > 0 && has_module_signature(buf, n);
 }
 
 DecoderProperties XMPDecoderFactory::properties() const
@@ -59,50 +82,127 @@ DecoderProperties XMPDecoderFactory::properties() const
   properties.shortName = "cas-xmp";
   properties.hasAbout = true;
   properties.hasSettings = true;
-  properties.noInput = true;
-  properties.protocols << "file";
+  properties.noInput = false;
+  properties.protocols << "file" << "xmp";
 
   return properties;
 }
 
-Decoder *XMPDecoderFactory::create(const QString &path, QIODevice *)
+Decoder *XMPDecoderFactory::create(const QString &path, QIODevice *input)
 {
-  return new XMPDecoder(path);
+  return new XMPDecoder(path, input);
+}
+
+static TrackInfo *make_track_info(const QString &path, const QString &filename, const ModuleInfo &info,
+                                  int sequence, TrackInfo::Parts parts, bool use_filename)
+{
+  TrackInfo *track_info = new TrackInfo(path);
+
+  if(parts & TrackInfo::Properties)
+  {
+    track_info->setValue(Qmmp::FORMAT_NAME, QString::fromStdString(info.format));
+    track_info->setDuration(sequence < int(info.sequences.size()) ? info.sequences[sequence].duration : info.duration);
+  }
+
+  if(parts & TrackInfo::MetaData)
+  {
+    if(use_filename)
+    {
+      track_info->setValue(Qmmp::TITLE, filename.section('/', -1));
+    }
+    else if(!info.title.empty())
+    {
+      track_info->setValue(Qmmp::TITLE, QString::fromStdString(info.title));
+    }
+
+    if(path != filename)
+    {
+      track_info->setValue(Qmmp::TRACK, QString::number(sequence + 1));
+    }
+  }
+
+  if(parts & TrackInfo::ReplayGainInfo)
+  {
+    if(sequence < int(info.sequences.size()) && info.sequences[sequence].analyzed &&
+       std::isfinite(info.sequences[sequence].loudness))
+    {
+      track_info->setValue(Qmmp::REPLAYGAIN_TRACK_GAIN, LoudnessMeter::replay_gain(info.sequences[sequence].loudness));
+      track_info->setValue(Qmmp::REPLAYGAIN_TRACK_PEAK, info.sequences[sequence].peak);
+    }
+  }
+
+  return track_info;
 }
 
-QList<TrackInfo *> XMPDecoderFactory::createPlayList(const QString &filename, TrackInfo::Parts parts, QStringList *)
+/* A plain file name gets one entry per sequence if there's more than
+ * one; an xmp:// URL refers to a single sequence.
+ */
+QList<TrackInfo *> XMPDecoderFactory::createPlayList(const QString &path, TrackInfo::Parts parts, QStringList *)
 {
   QList<TrackInfo *> list;
+  int sequence;
+  QString filename = parse_sequence_url(path, sequence);
+
+  XMPSettings::Snapshot settings = XMPSettings::snapshot();
+  bool use_filename = settings.use_filename;
 
-  if(parts & (TrackInfo::MetaData | TrackInfo::Properties))
+  if(parts & (TrackInfo::MetaData | TrackInfo::Properties | TrackInfo::ReplayGainInfo))
   {
-    try
+    ModuleInfo info;
+    bool found;
+
+    /* Only the duration (and sequence list) requires a full load; if
+     * nothing but metadata (i.e. the title) is wanted, and it's not
+     * cached already, a parse of the header is enough.
+     */
+    if(parts & TrackInfo::Properties)
     {
-      XMPWrap xmp(filename.toUtf8().constData());
-      TrackInfo *file_info = new TrackInfo(filename);
+      found = MetaDataCache::instance().lookup(filename, info);
 
-      if(parts & TrackInfo::Properties)
+      if(!found)
       {
-        file_info->setValue(Qmmp::FORMAT_NAME, QString::fromStdString(xmp.format()));
-        file_info->setDuration(xmp.duration());
+        ModuleScanner &scanner = ModuleScanner::instance();
+
+        scanner.prefetch_directory(filename, properties().filters);
+        found = scanner.get(filename, info);
       }
+    }
+    else if(parts & TrackInfo::MetaData)
+    {
+      found = MetaDataCache::instance().lookup(filename, info) ||
+              XMPWrap::probe(filename.toUtf8().constData(), info);
+    }
+    else
+    {
+      found = MetaDataCache::instance().lookup(filename, info);
+    }
 
-      if(parts & TrackInfo::MetaData)
+    /* Loudness is only known after analysis, which is left to the
+     * background; the playlist entry gets its ReplayGain information
+     * when it's next refreshed.
+     */
+    if(found && settings.analyze_loudness && !ModuleScanner::is_analyzed(info))
+    {
+      ModuleScanner::instance().analyze(QStringList() << filename);
+    }
+
+    if(found)
+    {
+      if(path != filename)
       {
-        if(settings.get_use_filename())
-        {
-          file_info->setValue(Qmmp::TITLE, filename.section('/', -1));
-        }
-        else if(!xmp.title().empty())
+        list << make_track_info(path, filename, info, sequence, parts, use_filename);
+      }
+      else if(info.sequences.size() > 1)
+      {
+        for(int i = 0; i < int(info.sequences.size()); i++)
         {
-          file_info->setValue(Qmmp::TITLE, QString::fromStdString(xmp.title()));
+          list << make_track_info(make_sequence_url(filename, i), filename, info, i, parts, use_filename);
         }
       }
-
-      list << file_info;
-    }
-    catch(const XMPWrap::InvalidFile &)
-    {
+      else
+      {
+        list << make_track_info(filename, filename, info, 0, parts, use_filename);
+      }
     }
   }
 
@@ -39,8 +39,6 @@
 #include <qmmp/decoderfactory.h>
 #include <qmmp/qmmp.h>
 
-#include "settings.h"
-
 class XMPDecoderFactory : public QObject, DecoderFactory
 {
   Q_OBJECT
@@ -48,6 +46,8 @@ class XMPDecoderFactory : public QObject, DecoderFactory
   Q_INTERFACES(DecoderFactory)
 
   public:
+    XMPDecoderFactory();
+
     bool canDecode(QIODevice *) const override;
     DecoderProperties properties() const override;
     Decoder *create(const QString &, QIODevice *) override;
@@ -56,9 +56,6 @@ class XMPDecoderFactory : public QObject, DecoderFactory
     void showSettings(QWidget *) override;
     void showAbout(QWidget *) override;
     QString translation() const override;
-
-  private:
-    XMPSettings settings;
 };
 
 #endif
@@ -0,0 +1,191 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <atomic>
+#include <cstdint>
+
+#include <QFile>
+#include <QIODevice>
+#include <QList>
+#include <QObject>
+#include <QPair>
+#include <QString>
+
+#include "decodestats.h"
+
+Histogram::Histogram()
+{
+  reset();
+}
+
+void Histogram::record(std::int64_t ns)
+{
+  int bucket = 0;
+
+  /* Bucket n holds durations of less than 2^n ns. */
+  for(std::uint64_t v = ns > 0 ? ns : 0; v != 0 && bucket < bucket_count - 1; v >>= 1)
+  {
+    bucket++;
+  }
+
+  buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+
+  std::int64_t max = max_.load(std::memory_order_relaxed);
+  while(ns > max && !max_.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+  {
+  }
+}
+
+void Histogram::reset()
+{
+  for(std::atomic<std::uint64_t> &bucket : buckets_)
+  {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  count_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+}
+
+/* An upper bound on the given percentile: the top of the bucket it falls
+ * in, which is within a factor of two.
+ */
+std::int64_t Histogram::percentile(int p) const
+{
+  std::uint64_t total = count();
+  std::uint64_t seen = 0;
+
+  if(total == 0)
+  {
+    return 0;
+  }
+
+  for(int i = 0; i < bucket_count; i++)
+  {
+    seen += buckets_[i].load(std::memory_order_relaxed);
+    if(seen * 100 >= total * p)
+    {
+      return std::int64_t(1) << i;
+    }
+  }
+
+  return max();
+}
+
+DecodeStats &DecodeStats::instance()
+{
+  static DecodeStats stats;
+
+  return stats;
+}
+
+void DecodeStats::record_read(std::int64_t ns, std::int64_t bytes, std::int64_t requested, std::int64_t audio_ns)
+{
+  read_time.record(ns);
+  bytes_copied.fetch_add(bytes, std::memory_order_relaxed);
+
+  if(bytes < requested)
+  {
+    short_reads.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  if(ns > audio_ns)
+  {
+    late_reads.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void DecodeStats::reset()
+{
+  read_time.reset();
+  frame_time.reset();
+  seek_time.reset();
+  load_time.reset();
+  track_change_time.reset();
+  buffered_time.reset();
+  short_reads.store(0, std::memory_order_relaxed);
+  late_reads.store(0, std::memory_order_relaxed);
+  bytes_copied.store(0, std::memory_order_relaxed);
+  downgrades.store(0, std::memory_order_relaxed);
+  upgrades.store(0, std::memory_order_relaxed);
+}
+
+static QString describe(const Histogram &histogram)
+{
+  if(histogram.count() == 0)
+  {
+    return QObject::tr("none");
+  }
+
+  return QObject::tr("%1; median < %2 µs, 99% < %3 µs, max %4 µs")
+         .arg(histogram.count())
+         .arg(histogram.percentile(50) / 1000.0, 0, 'f', 1)
+         .arg(histogram.percentile(99) / 1000.0, 0, 'f', 1)
+         .arg(histogram.max() / 1000.0, 0, 'f', 1);
+}
+
+QList<QPair<QString, QString>> DecodeStats::items() const
+{
+  QList<QPair<QString, QString>> items;
+
+  items.append(QPair<QString, QString>(QObject::tr("Reads"), describe(read_time)));
+  items.append(QPair<QString, QString>(QObject::tr("Short reads"), QString::number(short_reads.load(std::memory_order_relaxed))));
+  items.append(QPair<QString, QString>(QObject::tr("Late reads"), QString::number(late_reads.load(std::memory_order_relaxed))));
+  items.append(QPair<QString, QString>(QObject::tr("Bytes copied"), QString::number(bytes_copied.load(std::memory_order_relaxed))));
+  items.append(QPair<QString, QString>(QObject::tr("Frames rendered"), describe(frame_time)));
+  items.append(QPair<QString, QString>(QObject::tr("Seeks"), describe(seek_time)));
+  items.append(QPair<QString, QString>(QObject::tr("Module loads"), describe(load_time)));
+  items.append(QPair<QString, QString>(QObject::tr("Track changes"), describe(track_change_time)));
+  items.append(QPair<QString, QString>(QObject::tr("Buffered audio"), describe(buffered_time)));
+  items.append(QPair<QString, QString>(QObject::tr("Interpolator downgrades"), QString::number(downgrades.load(std::memory_order_relaxed))));
+  items.append(QPair<QString, QString>(QObject::tr("Interpolator upgrades"), QString::number(upgrades.load(std::memory_order_relaxed))));
+
+  return items;
+}
+
+QString DecodeStats::report() const
+{
+  QString text;
+
+  for(const auto &item : items())
+  {
+    text += item.first + ": " + item.second + "\n";
+  }
+
+  return text;
+}
+
+bool DecodeStats::save(const QString &filename) const
+{
+  QFile file(filename);
+
+  if(!file.open(QIODevice::WriteOnly | QIODevice::Text))
+  {
+    return false;
+  }
+
+  return file.write(report().toUtf8()) != -1;
+}
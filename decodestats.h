@@ -0,0 +1,123 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef QMMP_XMP_DECODESTATS_H
+#define QMMP_XMP_DECODESTATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include <QList>
+#include <QPair>
+#include <QString>
+
+/* Nanoseconds on the steady clock, for timing what is recorded here. */
+inline std::int64_t now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* A histogram of durations in nanoseconds, with one bucket per power of
+ * two.  Recording is a couple of relaxed atomic increments, so any thread
+ * can record without locking; readers get a view which may be slightly
+ * inconsistent while recording goes on, which is fine for statistics.
+ */
+class Histogram
+{
+  public:
+    Histogram();
+
+    void record(std::int64_t);
+    void reset();
+
+    std::uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    std::int64_t max() const { return max_.load(std::memory_order_relaxed); }
+    std::int64_t percentile(int) const;
+
+  private:
+    static const int bucket_count = 48;
+
+    std::atomic<std::uint64_t> buckets_[bucket_count];
+    std::atomic<std::uint64_t> count_;
+    std::atomic<std::int64_t> max_;
+};
+
+/* Process-wide decoding statistics, to tell whether stutter comes from
+ * the decoder or from further down the line.  Decoders only record when
+ * statistics are enabled in the settings, so otherwise they cost nothing
+ * but a test of a flag.
+ *
+ * A track change is timed from the end of one track's audio to the first
+ * audio of the next.
+ *
+ * A late read is one which took longer than the audio it returned lasts:
+ * if reads are late, the decoder can't keep up.  Buffered audio is what
+ * the decoder has rendered but not yet returned after each read, which
+ * is the latency it adds.
+ */
+class DecodeStats
+{
+  public:
+    static DecodeStats &instance();
+
+    void record_read(std::int64_t ns, std::int64_t bytes, std::int64_t requested, std::int64_t audio_ns);
+    void record_frame(std::int64_t ns) { frame_time.record(ns); }
+    void record_seek(std::int64_t ns) { seek_time.record(ns); }
+    void record_load(std::int64_t ns) { load_time.record(ns); }
+    void record_track_change(std::int64_t ns) { track_change_time.record(ns); }
+    void record_buffered(std::int64_t ns) { buffered_time.record(ns); }
+
+    /* Interpolator changes made by the governor are rare, so they are
+     * always counted, whether or not statistics are enabled.
+     */
+    void record_downgrade() { downgrades.fetch_add(1, std::memory_order_relaxed); }
+    void record_upgrade() { upgrades.fetch_add(1, std::memory_order_relaxed); }
+    void reset();
+
+    QList<QPair<QString, QString>> items() const;
+    QString report() const;
+    bool save(const QString &) const;
+
+  private:
+    DecodeStats() { }
+    DecodeStats(const DecodeStats &) = delete;
+    DecodeStats &operator=(const DecodeStats &) = delete;
+
+    Histogram read_time;
+    Histogram frame_time;
+    Histogram seek_time;
+    Histogram load_time;
+    Histogram track_change_time;
+    Histogram buffered_time;
+    std::atomic<std::uint64_t> short_reads{0};
+    std::atomic<std::uint64_t> late_reads{0};
+    std::atomic<std::uint64_t> bytes_copied{0};
+    std::atomic<std::uint64_t> downgrades{0};
+    std::atomic<std::uint64_t> upgrades{0};
+};
+
+#endif
@@ -0,0 +1,129 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <cstdint>
+
+#include <QtDebug>
+
+#include "decodestats.h"
+#include "governor.h"
+#include "xmpwrap.h"
+
+namespace
+{
+  /* From cheapest to most expensive. */
+  const int levels[] = { XMPWrap::interp_nearest, XMPWrap::interp_linear, XMPWrap::interp_spline };
+  const char *const level_names[] = { "nearest neighbor", "linear", "spline" };
+  const int level_count = sizeof levels / sizeof *levels;
+}
+
+constexpr double RenderGovernor::high_load;
+constexpr double RenderGovernor::low_load;
+
+RenderGovernor::RenderGovernor()
+{
+  reset(XMPWrap::default_interpolator());
+}
+
+/* Start over at the specified interpolator, as when a new module is
+ * started or the user picks a different interpolator.
+ */
+void RenderGovernor::reset(int interpolator)
+{
+  ceiling_ = level_index(interpolator);
+  level_ = ceiling_;
+  render_ns_ = 0;
+  audio_ns_ = 0;
+  quiet_windows_ = 0;
+}
+
+int RenderGovernor::interpolator() const
+{
+  return levels[level_];
+}
+
+int RenderGovernor::level_index(int interpolator) const
+{
+  for(int i = 0; i < level_count; i++)
+  {
+    if(levels[i] == interpolator)
+    {
+      return i;
+    }
+  }
+
+  return level_count - 1;
+}
+
+/* Account for a read, returning true if the interpolator should change
+ * (to interpolator()).
+ */
+bool RenderGovernor::update(std::int64_t render_ns, std::int64_t audio_ns)
+{
+  render_ns_ += render_ns;
+  audio_ns_ += audio_ns;
+
+  if(audio_ns_ < window_ns)
+  {
+    return false;
+  }
+
+  double load = static_cast<double>(render_ns_) / audio_ns_;
+  int previous = level_;
+
+  render_ns_ = 0;
+  audio_ns_ = 0;
+
+  if(load > high_load && level_ > 0)
+  {
+    level_--;
+    quiet_windows_ = 0;
+    DecodeStats::instance().record_downgrade();
+  }
+  else if(load < low_load && level_ < ceiling_)
+  {
+    if(++quiet_windows_ == upgrade_windows)
+    {
+      level_++;
+      quiet_windows_ = 0;
+      DecodeStats::instance().record_upgrade();
+    }
+  }
+  else
+  {
+    quiet_windows_ = 0;
+  }
+
+  if(level_ == previous)
+  {
+    return false;
+  }
+
+  qDebug("RenderGovernor: rendering at %.0f%% of real time, switching from %s to %s interpolation",
+         load * 100, level_names[previous], level_names[level_]);
+
+  return true;
+}
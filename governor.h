@@ -0,0 +1,68 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef QMMP_XMP_GOVERNOR_H
+#define QMMP_XMP_GOVERNOR_H
+
+#include <cstdint>
+
+/* Trades interpolation quality for speed when rendering can't keep up.
+ * The decoder reports how long each read took to render and how long the
+ * audio it produced lasts; over windows of half a second of audio, if
+ * rendering takes too large a share of real time, the interpolator is
+ * stepped down (spline, linear, nearest neighbor).  It is only stepped
+ * back up after the load has stayed low for several windows, and the
+ * thresholds are far enough apart that the more expensive interpolator
+ * shouldn't immediately trip the limit again.  The user's interpolator is
+ * the ceiling.
+ */
+class RenderGovernor
+{
+  public:
+    RenderGovernor();
+
+    void reset(int);
+    bool update(std::int64_t render_ns, std::int64_t audio_ns);
+    int interpolator() const;
+
+  private:
+    static const std::int64_t window_ns = 500000000;
+    static const int upgrade_windows = 4;
+
+    /* Fractions of real time spent rendering. */
+    static constexpr double high_load = 0.75;
+    static constexpr double low_load = 0.3;
+
+    int level_index(int) const;
+
+    int ceiling_ = 0;
+    int level_ = 0;
+    std::int64_t render_ns_ = 0;
+    std::int64_t audio_ns_ = 0;
+    int quiet_windows_ = 0;
+};
+
+#endif
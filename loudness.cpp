@@ -0,0 +1,119 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "loudness.h"
+
+constexpr double LoudnessMeter::reference_loudness;
+
+/* The K-weighting filters are given in BS.1770 as coefficients for 48
+ * kHz only; these are derived from the analog prototypes (as libebur128
+ * does), so any rate works.
+ */
+LoudnessMeter::LoudnessMeter(int rate) : step_size(rate / 10)
+{
+  const double pi = 3.14159265358979323846;
+  double f0, q, k, vh, vb, a0;
+
+  f0 = 1681.974450955533;
+  q = 0.7071752369554196;
+  k = std::tan(pi * f0 / rate);
+  vh = std::pow(10.0, 3.999843853973347 / 20);
+  vb = std::pow(vh, 0.4996667741545416);
+  a0 = 1 + k / q + k * k;
+  shelf = Biquad{(vh + vb * k / q + k * k) / a0, 2 * (k * k - vh) / a0, (vh - vb * k / q + k * k) / a0,
+                 2 * (k * k - 1) / a0, (1 - k / q + k * k) / a0, {0, 0}, {0, 0}};
+
+  f0 = 38.13547087602444;
+  q = 0.5003270373238773;
+  k = std::tan(pi * f0 / rate);
+  a0 = 1 + k / q + k * k;
+  highpass = Biquad{1, -2, 1, 2 * (k * k - 1) / a0, (1 - k / q + k * k) / a0, {0, 0}, {0, 0}};
+}
+
+void LoudnessMeter::add(const std::int16_t *samples, std::size_t frames)
+{
+  for(std::size_t i = 0; i < frames; i++)
+  {
+    for(int channel = 0; channel < 2; channel++)
+    {
+      double x = samples[i * 2 + channel] / 32768.0;
+      double y = highpass.process(channel, shelf.process(channel, x));
+
+      peak_ = std::fmax(peak_, std::fabs(x));
+      step_energy += y * y;
+    }
+
+    if(++step_fill == step_size)
+    {
+      steps.push_back(step_energy / step_size);
+      step_fill = 0;
+      step_energy = 0;
+    }
+  }
+}
+
+double LoudnessMeter::loudness() const
+{
+  const double absolute_gate = -70;
+  std::vector<double> blocks;
+  double sum = 0;
+  size_t count = 0;
+
+  for(size_t i = 0; i + 4 <= steps.size(); i++)
+  {
+    double energy = (steps[i] + steps[i + 1] + steps[i + 2] + steps[i + 3]) / 4;
+
+    if(-0.691 + 10 * std::log10(energy) > absolute_gate)
+    {
+      blocks.push_back(energy);
+      sum += energy;
+    }
+  }
+
+  if(blocks.empty())
+  {
+    return -HUGE_VAL;
+  }
+
+  double relative_gate = -0.691 + 10 * std::log10(sum / blocks.size()) - 10;
+
+  sum = 0;
+  for(double energy : blocks)
+  {
+    if(-0.691 + 10 * std::log10(energy) > relative_gate)
+    {
+      sum += energy;
+      count++;
+    }
+  }
+
+  return -0.691 + 10 * std::log10(sum / count);
+}
@@ -0,0 +1,89 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef QMMP_XMP_LOUDNESS_H
+#define QMMP_XMP_LOUDNESS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Integrated loudness as specified by ITU-R BS.1770-4 (and so EBU R128):
+ * K-weighting, 400 ms blocks overlapping by 75%, an absolute gate at -70
+ * LUFS and a relative gate 10 LU below the ungated level.  The peak is
+ * the sample peak, not the oversampled true peak.
+ *
+ * Input is interleaved 16-bit stereo at any rate.
+ */
+class LoudnessMeter
+{
+  public:
+    explicit LoudnessMeter(int rate);
+
+    void add(const std::int16_t *, std::size_t frames);
+
+    /* In LUFS; very low (-HUGE_VAL) for silence. */
+    double loudness() const;
+
+    /* Relative to full scale. */
+    double peak() const { return peak_; }
+
+    /* The gain, in dB, which brings a loudness to ReplayGain 2.0's
+     * reference level of -18 LUFS.
+     */
+    static double replay_gain(double loudness) { return reference_loudness - loudness; }
+
+    static constexpr double reference_loudness = -18.0;
+
+  private:
+    struct Biquad
+    {
+      double b0, b1, b2, a1, a2;
+      double z1[2], z2[2];
+
+      double process(int channel, double x)
+      {
+        double y = b0 * x + z1[channel];
+
+        z1[channel] = b1 * x - a1 * y + z2[channel];
+        z2[channel] = b2 * x - a2 * y;
+
+        return y;
+      }
+    };
+
+    Biquad shelf;
+    Biquad highpass;
+    int step_size;
+    int step_fill = 0;
+    double step_energy = 0;
+
+    /* Mean square (summed over channels) of each 100 ms step. */
+    std::vector<double> steps;
+    double peak_ = 0;
+};
+
+#endif
@@ -0,0 +1,403 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QIODevice>
+#include <QList>
+#include <QSaveFile>
+#include <QString>
+#include <QtGlobal>
+
+#include <qmmp/qmmp.h>
+
+#include "metadatacache.h"
+#include "moduleinfo.h"
+#include "xmpwrap.h"
+
+namespace
+{
+  const quint32 cache_magic = 0x584d5043; /* "XMPC" */
+  const quint32 cache_version = 3;
+
+  /* How many new entries to collect before appending them to the file. */
+  const int append_threshold = 64;
+
+  QByteArray to_bytes(const std::string &s)
+  {
+    return QByteArray(s.data(), static_cast<int>(s.size()));
+  }
+
+  std::string from_bytes(const QByteArray &b)
+  {
+    return std::string(b.constData(), b.size());
+  }
+
+  void write_strings(QDataStream &stream, const std::vector<std::string> &strings)
+  {
+    stream << quint32(strings.size());
+    for(const std::string &s : strings)
+    {
+      stream << to_bytes(s);
+    }
+  }
+
+  void read_strings(QDataStream &stream, std::vector<std::string> &strings)
+  {
+    quint32 n;
+    QByteArray b;
+
+    stream >> n;
+    strings.clear();
+    for(quint32 i = 0; i < n && stream.status() == QDataStream::Ok; i++)
+    {
+      stream >> b;
+      strings.push_back(from_bytes(b));
+    }
+  }
+
+  void write_info(QDataStream &stream, const ModuleInfo &info)
+  {
+    stream << qint32(info.duration)
+           << to_bytes(info.title)
+           << to_bytes(info.format)
+           << qint32(info.pattern_count)
+           << qint32(info.track_count)
+           << qint32(info.channel_count)
+           << QByteArray(info.channel_pan.data(), static_cast<int>(info.channel_pan.size()))
+           << qint32(info.instrument_count)
+           << qint32(info.sample_count)
+           << qint32(info.initial_speed)
+           << qint32(info.initial_bpm)
+           << qint32(info.length);
+    write_strings(stream, info.instruments);
+    write_strings(stream, info.samples);
+    stream << to_bytes(info.comment);
+
+    stream << quint32(info.sequences.size());
+    for(const ModuleInfo::Sequence &sequence : info.sequences)
+    {
+      stream << qint32(sequence.entry_point) << qint32(sequence.duration)
+             << sequence.analyzed << sequence.loudness << sequence.peak;
+    }
+  }
+
+  void read_info(QDataStream &stream, ModuleInfo &info)
+  {
+    qint32 duration, pattern_count, track_count, channel_count, instrument_count, sample_count;
+    qint32 initial_speed, initial_bpm, length;
+    QByteArray title, format, channel_pan, comment;
+
+    stream >> duration >> title >> format >> pattern_count >> track_count >> channel_count
+           >> channel_pan >> instrument_count >> sample_count >> initial_speed >> initial_bpm >> length;
+    read_strings(stream, info.instruments);
+    read_strings(stream, info.samples);
+    stream >> comment;
+
+    quint32 n;
+    stream >> n;
+    info.sequences.clear();
+    for(quint32 i = 0; i < n && stream.status() == QDataStream::Ok; i++)
+    {
+      qint32 entry_point, sequence_duration;
+      ModuleInfo::Sequence sequence(0, 0);
+
+      stream >> entry_point >> sequence_duration >> sequence.analyzed >> sequence.loudness >> sequence.peak;
+      sequence.entry_point = entry_point;
+      sequence.duration = sequence_duration;
+      info.sequences.push_back(sequence);
+    }
+
+    info.duration = duration;
+    info.title = from_bytes(title);
+    info.format = from_bytes(format);
+    info.pattern_count = pattern_count;
+    info.track_count = track_count;
+    info.channel_count = channel_count;
+    info.channel_pan.assign(channel_pan.constData(), channel_pan.constData() + channel_pan.size());
+    info.instrument_count = instrument_count;
+    info.sample_count = sample_count;
+    info.initial_speed = initial_speed;
+    info.initial_bpm = initial_bpm;
+    info.length = length;
+    info.comment = from_bytes(comment);
+  }
+}
+
+MetaDataCache &MetaDataCache::instance()
+{
+  static MetaDataCache cache;
+
+  return cache;
+}
+
+MetaDataCache::MetaDataCache() : filename(Qmmp::configDir() + "/cas-xmp-metadata.cache")
+{
+}
+
+MetaDataCache::~MetaDataCache()
+{
+  flush();
+}
+
+/* Called once, when the plugin is created. */
+void MetaDataCache::preload()
+{
+  preloading = std::async(std::launch::async, [this]() { std::call_once(loaded, &MetaDataCache::load, this); });
+}
+
+/* Look the path up in the cache, falling back to loading the module with
+ * libxmp (and caching the result) on a miss.  Returns false if the file
+ * isn't a module libxmp can play.  If fill_cache is set, the module file
+ * is kept in the module cache (see XMPWrap).
+ */
+bool MetaDataCache::get(const QString &path, ModuleInfo &info, bool fill_cache)
+{
+  if(lookup(path, info))
+  {
+    return true;
+  }
+
+  try
+  {
+    XMPWrap xmp(path.toUtf8().constData(), -1, XMPWrap::default_rate(), 0, fill_cache);
+    info = xmp.info();
+  }
+  catch(const XMPWrap::InvalidFile &)
+  {
+    return false;
+  }
+
+  insert(path, info);
+
+  return true;
+}
+
+bool MetaDataCache::lookup(const QString &path, ModuleInfo &info)
+{
+  qint64 size, mtime;
+
+  if(!stat(path, size, mtime))
+  {
+    return false;
+  }
+
+  std::call_once(loaded, &MetaDataCache::load, this);
+  std::lock_guard<std::mutex> lock(mutex);
+
+  auto it = entries.constFind(path);
+  if(it == entries.constEnd() || it->size != size || it->mtime != mtime)
+  {
+    return false;
+  }
+
+  info = it->info;
+
+  return true;
+}
+
+void MetaDataCache::insert(const QString &path, const ModuleInfo &info)
+{
+  Entry entry;
+
+  if(!stat(path, entry.size, entry.mtime))
+  {
+    return;
+  }
+
+  entry.info = info;
+
+  std::call_once(loaded, &MetaDataCache::load, this);
+  std::lock_guard<std::mutex> lock(mutex);
+
+  entries.insert(path, entry);
+  pending.append(path);
+
+  if(pending.size() >= append_threshold)
+  {
+    append(pending);
+    pending.clear();
+  }
+}
+
+void MetaDataCache::flush()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if(!pending.isEmpty())
+  {
+    append(pending);
+    pending.clear();
+  }
+}
+
+bool MetaDataCache::stat(const QString &path, qint64 &size, qint64 &mtime)
+{
+  QFileInfo file_info(path);
+
+  if(!file_info.isFile())
+  {
+    return false;
+  }
+
+  size = file_info.size();
+  mtime = file_info.lastModified().toMSecsSinceEpoch();
+
+  return true;
+}
+
+/* Called once only, through the once flag, so nothing else can touch the
+ * entries until this returns.  The file is parsed without the mutex, and
+ * only what follows (a rewrite, if needed) holds it.
+ */
+void MetaDataCache::load()
+{
+  QFile file(filename);
+  QHash<QString, Entry> loaded_entries;
+  int loaded_records = 0;
+  quint32 magic, version;
+  bool truncated = false;
+
+  if(!file.open(QIODevice::ReadOnly))
+  {
+    return;
+  }
+
+  QDataStream stream(&file);
+  stream.setVersion(QDataStream::Qt_5_0);
+
+  stream >> magic >> version;
+  if(stream.status() != QDataStream::Ok || magic != cache_magic || version != cache_version)
+  {
+    /* Unknown or outdated: start over. */
+    file.close();
+    QFile::remove(filename);
+    return;
+  }
+
+  while(!stream.atEnd())
+  {
+    QString path;
+    Entry entry;
+
+    stream >> path >> entry.size >> entry.mtime;
+    read_info(stream, entry.info);
+
+    if(stream.status() != QDataStream::Ok)
+    {
+      truncated = true;
+      break;
+    }
+
+    loaded_entries.insert(path, entry);
+    loaded_records++;
+  }
+
+  file.close();
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  entries.swap(loaded_entries);
+  records = loaded_records;
+
+  /* Rewrite if the last append was cut short, or if there are a lot
+   * of superseded records.
+   */
+  if(truncated || records > 2 * entries.size() + 1024)
+  {
+    rewrite();
+  }
+}
+
+/* Must be called with the mutex held. */
+void MetaDataCache::rewrite()
+{
+  QSaveFile file(filename);
+
+  QDir().mkpath(QFileInfo(filename).absolutePath());
+
+  if(!file.open(QIODevice::WriteOnly))
+  {
+    return;
+  }
+
+  QDataStream stream(&file);
+  stream.setVersion(QDataStream::Qt_5_0);
+
+  stream << cache_magic << cache_version;
+  for(auto it = entries.constBegin(); it != entries.constEnd(); ++it)
+  {
+    stream << it.key() << it->size << it->mtime;
+    write_info(stream, it->info);
+  }
+
+  if(file.commit())
+  {
+    records = entries.size();
+  }
+}
+
+/* Must be called with the mutex held. */
+void MetaDataCache::append(const QList<QString> &paths)
+{
+  QFile file(filename);
+
+  QDir().mkpath(QFileInfo(filename).absolutePath());
+
+  if(!file.open(QIODevice::WriteOnly | QIODevice::Append))
+  {
+    return;
+  }
+
+  QDataStream stream(&file);
+  stream.setVersion(QDataStream::Qt_5_0);
+
+  if(file.size() == 0)
+  {
+    stream << cache_magic << cache_version;
+  }
+
+  for(const QString &path : paths)
+  {
+    auto it = entries.constFind(path);
+    if(it != entries.constEnd())
+    {
+      stream << path << it->size << it->mtime;
+      write_info(stream, it->info);
+      records++;
+    }
+  }
+}
@@ -0,0 +1,93 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef QMMP_XMP_METADATACACHE_H
+#define QMMP_XMP_METADATACACHE_H
+
+#include <future>
+#include <mutex>
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QtGlobal>
+
+#include "moduleinfo.h"
+
+/* A persistent cache of module information, so that playlists and the
+ * details dialog don't need libxmp to load (and scan) every module each
+ * time.  Entries are keyed by path and are only used while the file's
+ * size and modification time are unchanged.
+ *
+ * The cache file is a log: new entries are appended in batches, and when
+ * it is read back later records override earlier ones.  It is rewritten
+ * from scratch only when it has accumulated too many stale records.
+ *
+ * The file is read once, before the first lookup or insertion, which
+ * wait for it.  preload() starts reading it in the background, so that
+ * the first track played needn't wait for the whole file to be parsed.
+ */
+class MetaDataCache
+{
+  public:
+    static MetaDataCache &instance();
+
+    void preload();
+    bool get(const QString &, ModuleInfo &, bool = false);
+    bool lookup(const QString &, ModuleInfo &);
+    void insert(const QString &, const ModuleInfo &);
+    void flush();
+
+  private:
+    struct Entry
+    {
+      qint64 size;
+      qint64 mtime;
+      ModuleInfo info;
+    };
+
+    MetaDataCache();
+    ~MetaDataCache();
+    MetaDataCache(const MetaDataCache &) = delete;
+    MetaDataCache &operator=(const MetaDataCache &) = delete;
+
+    static bool stat(const QString &, qint64 &, qint64 &);
+    void load();
+    void rewrite();
+    void append(const QList<QString> &);
+
+    QString filename;
+    std::once_flag loaded;
+    std::mutex mutex;
+    QHash<QString, Entry> entries;
+    QList<QString> pending;
+    int records = 0;
+
+    /* Last, so that it's waited for before anything else is destroyed. */
+    std::future<void> preloading;
+};
+
+#endif
@@ -32,65 +32,85 @@
 
 #include <qmmp/metadatamodel.h>
 
+#include "decodestats.h"
+#include "metadatacache.h"
 #include "metadatamodel.h"
-#include "xmpwrap.h"
+#include "moduleinfo.h"
+#include "sequenceurl.h"
+#include "settings.h"
 
 XMPMetaDataModel::XMPMetaDataModel(const QString &path) :
   MetaDataModel(true)
 {
-  try
+  ModuleInfo info;
+  int sequence;
+
+  /* The details dialog is usually opened for something about to be (or
+   * being) played, so the file is worth keeping.
+   */
+  if(MetaDataCache::instance().get(parse_sequence_url(path, sequence), info, true))
+  {
+    fill_in_extra_properties(info);
+    fill_in_descriptions(info);
+  }
+
+  if(XMPSettings::snapshot().collect_stats)
   {
-    XMPWrap xmp(path.toUtf8().constData());
-    fill_in_extra_properties(xmp);
-    fill_in_descriptions(xmp);
+    fill_in_stats();
   }
-  catch(const XMPWrap::InvalidFile &)
+}
+
+/* The statistics are for all decoding so far, not for this module. */
+void XMPMetaDataModel::fill_in_stats()
+{
+  for(const auto &item : DecodeStats::instance().items())
   {
+    ap << MetaDataItem(tr("Decoder: %1").arg(item.first), item.second);
   }
 }
 
-void XMPMetaDataModel::fill_in_extra_properties(XMPWrap &xmp)
+void XMPMetaDataModel::fill_in_extra_properties(const ModuleInfo &info)
 {
   QString text;
   auto is_empty_string = [](const std::string &s) { return s == ""; };
 
-  if(!std::all_of(xmp.instruments().begin(), xmp.instruments().end(), is_empty_string))
+  if(!std::all_of(info.instruments.begin(), info.instruments.end(), is_empty_string))
   {
-    for(const std::string &s : xmp.instruments())
+    for(const std::string &s : info.instruments)
     {
       text += QString::fromStdString(s) + "\n";
     }
     desc << MetaDataItem(tr("Instruments"), text);
   }
 
-  if(!std::all_of(xmp.samples().begin(), xmp.samples().end(), is_empty_string))
+  if(!std::all_of(info.samples.begin(), info.samples.end(), is_empty_string))
   {
     text = "";
-    for(const std::string &s : xmp.samples())
+    for(const std::string &s : info.samples)
     {
       text += QString::fromStdString(s) + "\n";
     }
     desc << MetaDataItem(tr("Samples"), text);
   }
 
-  if(!xmp.comment().empty())
+  if(!info.comment.empty())
   {
-    desc << MetaDataItem(tr("Comment"), QString::fromStdString(xmp.comment()));
+    desc << MetaDataItem(tr("Comment"), QString::fromStdString(info.comment));
   }
 }
 
-void XMPMetaDataModel::fill_in_descriptions(XMPWrap &xmp)
+void XMPMetaDataModel::fill_in_descriptions(const ModuleInfo &info)
 {
-  ap << MetaDataItem(tr("Patterns"), QString::number(xmp.pattern_count()));
-  ap << MetaDataItem(tr("Tracks"), QString::number(xmp.track_count()));
-  ap << MetaDataItem(tr("Instruments"), QString::number(xmp.instrument_count()));
-  ap << MetaDataItem(tr("Samples"), QString::number(xmp.sample_count()));
-  ap << MetaDataItem(tr("Initial speed"), QString::number(xmp.initial_speed()));
-  ap << MetaDataItem(tr("Initial BPM"), QString::number(xmp.initial_bpm()));
-  ap << MetaDataItem(tr("Length"), tr("%1 patterns").arg(xmp.length()));
-
-  QString channels = QString::number(xmp.channel_count()) + " [ ";
-  for(const char &pan : xmp.channel_pan())
+  ap << MetaDataItem(tr("Patterns"), QString::number(info.pattern_count));
+  ap << MetaDataItem(tr("Tracks"), QString::number(info.track_count));
+  ap << MetaDataItem(tr("Instruments"), QString::number(info.instrument_count));
+  ap << MetaDataItem(tr("Samples"), QString::number(info.sample_count));
+  ap << MetaDataItem(tr("Initial speed"), QString::number(info.initial_speed));
+  ap << MetaDataItem(tr("Initial BPM"), QString::number(info.initial_bpm));
+  ap << MetaDataItem(tr("Length"), tr("%1 patterns").arg(info.length));
+
+  QString channels = QString::number(info.channel_count) + " [ ";
+  for(const char &pan : info.channel_pan)
   {
     channels += pan;
     channels += ' ';
@@ -33,7 +33,7 @@
 
 #include <qmmp/metadatamodel.h>
 
-#include "xmpwrap.h"
+#include "moduleinfo.h"
 
 class XMPMetaDataModel : public MetaDataModel
 {
@@ -46,8 +46,9 @@ class XMPMetaDataModel : public MetaDataModel
     QList<MetaDataItem> descriptions() const override;
 
   private:
-    void fill_in_extra_properties(XMPWrap &);
-    void fill_in_descriptions(XMPWrap &);
+    void fill_in_extra_properties(const ModuleInfo &);
+    void fill_in_descriptions(const ModuleInfo &);
+    void fill_in_stats();
 
     QList<MetaDataItem> ap;
     QList<MetaDataItem> desc;
@@ -0,0 +1,171 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <list>
+#include <mutex>
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QIODevice>
+#include <QString>
+#include <QtGlobal>
+
+#include "modulecache.h"
+
+ModuleCache &ModuleCache::instance()
+{
+  static ModuleCache cache;
+
+  return cache;
+}
+
+/* Return the contents of the file, from the cache if they are there and
+ * the file hasn't changed since.  A null array means the file is either
+ * unreadable or too big for the budget, and should be loaded some other
+ * way.
+ */
+QByteArray ModuleCache::get(const QString &filename)
+{
+  QFileInfo file_info(filename);
+  qint64 size = file_info.size();
+  qint64 mtime = file_info.lastModified().toMSecsSinceEpoch();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    QByteArray data = lookup(filename, size, mtime);
+    if(!data.isNull())
+    {
+      return data;
+    }
+
+    if(size <= 0 || size > budget)
+    {
+      return QByteArray();
+    }
+  }
+
+  /* Read without holding the lock; if another thread reads the same file
+   * meanwhile, the later insertion wins.
+   */
+  QFile file(filename);
+  if(!file.open(QIODevice::ReadOnly))
+  {
+    return QByteArray();
+  }
+
+  QByteArray data = file.readAll();
+  if(data.size() != size)
+  {
+    return QByteArray();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  auto it = entries.find(filename);
+  if(it != entries.end())
+  {
+    drop(it);
+  }
+
+  evict(budget - size);
+
+  uses.push_front(filename);
+  entries.insert(filename, Entry{size, mtime, data, uses.begin()});
+  used += size;
+
+  return data;
+}
+
+/* Return the contents of the file if they are cached and the file hasn't
+ * changed since, without reading it otherwise.
+ */
+QByteArray ModuleCache::find(const QString &filename)
+{
+  QFileInfo file_info(filename);
+  std::lock_guard<std::mutex> lock(mutex);
+
+  return lookup(filename, file_info.size(), file_info.lastModified().toMSecsSinceEpoch());
+}
+
+/* The caller holds the lock.  A stale entry is dropped. */
+QByteArray ModuleCache::lookup(const QString &filename, qint64 size, qint64 mtime)
+{
+  auto it = entries.find(filename);
+  if(it == entries.end())
+  {
+    return QByteArray();
+  }
+
+  if(it->size != size || it->mtime != mtime)
+  {
+    drop(it);
+    return QByteArray();
+  }
+
+  uses.splice(uses.begin(), uses, it->use);
+
+  return it->data;
+}
+
+void ModuleCache::remove(const QString &filename)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+
+  auto it = entries.find(filename);
+  if(it != entries.end())
+  {
+    drop(it);
+  }
+}
+
+void ModuleCache::set_budget(qint64 bytes)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+
+  budget = qMax(bytes, qint64(0));
+  evict(budget);
+}
+
+/* Drop least recently used entries until no more than the given number
+ * of bytes are in use.  The caller holds the lock.
+ */
+void ModuleCache::evict(qint64 limit)
+{
+  while(used > limit && !uses.empty())
+  {
+    drop(entries.find(uses.back()));
+  }
+}
+
+void ModuleCache::drop(QHash<QString, Entry>::iterator it)
+{
+  used -= it->data.size();
+  uses.erase(it->use);
+  entries.erase(it);
+}
@@ -0,0 +1,86 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef QMMP_XMP_MODULECACHE_H
+#define QMMP_XMP_MODULECACHE_H
+
+#include <list>
+#include <mutex>
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QtGlobal>
+
+/* The contents of recently played module files, so that the details
+ * dialog and the decoder, which load the same file in quick succession,
+ * only read it from disk once.  Only get() reads and adds files; other
+ * loads (such as a playlist import, which would churn through the cache
+ * with files that won't be opened again soon) use find(), which only
+ * returns what's already there.  The total size of the
+ * cached files is kept within a budget by dropping the least recently
+ * used ones.  The data is handed out as QByteArrays, which share it, so
+ * an entry dropped while in use lives on until its last user is done.
+ */
+class ModuleCache
+{
+  public:
+    static ModuleCache &instance();
+
+    static const qint64 default_budget = 64 * 1024 * 1024;
+
+    QByteArray get(const QString &);
+    QByteArray find(const QString &);
+    void remove(const QString &);
+    void set_budget(qint64);
+
+  private:
+    struct Entry
+    {
+      qint64 size;
+      qint64 mtime;
+      QByteArray data;
+      std::list<QString>::iterator use;
+    };
+
+    ModuleCache() { }
+    ModuleCache(const ModuleCache &) = delete;
+    ModuleCache &operator=(const ModuleCache &) = delete;
+
+    QByteArray lookup(const QString &, qint64, qint64);
+    void evict(qint64);
+    void drop(QHash<QString, Entry>::iterator);
+
+    std::mutex mutex;
+    qint64 budget = default_budget;
+    qint64 used = 0;
+    QHash<QString, Entry> entries;
+
+    /* Most recently used first. */
+    std::list<QString> uses;
+};
+
+#endif
@@ -0,0 +1,74 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef QMMP_XMP_MODULEINFO_H
+#define QMMP_XMP_MODULEINFO_H
+
+#include <string>
+#include <vector>
+
+/* Everything that's shown about a module without playing it.  This is a
+ * plain value so that it can outlive the libxmp context it came from and
+ * be stored in the metadata cache.
+ */
+struct ModuleInfo
+{
+  /* libxmp finds "hidden" subsongs by scanning the order list; each one
+   * starts at its own position.  The first sequence is the main song,
+   * and its duration is also found in duration.
+   *
+   * Loudness (in LUFS) and peak are only known once the sequence has been
+   * rendered by the background analysis, which sets analyzed.
+   */
+  struct Sequence
+  {
+    Sequence(int entry_point, int duration) : entry_point(entry_point), duration(duration) { }
+    int entry_point;
+    int duration;
+    bool analyzed = false;
+    double loudness = 0;
+    double peak = 0;
+  };
+
+  int duration = 0;
+  std::vector<Sequence> sequences;
+  std::string title;
+  std::string format;
+  int pattern_count = 0;
+  int track_count = 0;
+  int channel_count = 0;
+  std::vector<char> channel_pan;
+  int instrument_count = 0;
+  int sample_count = 0;
+  int initial_speed = 0;
+  int initial_bpm = 0;
+  int length = 0;
+  std::vector<std::string> instruments;
+  std::vector<std::string> samples;
+  std::string comment;
+};
+
+#endif
@@ -0,0 +1,272 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "decodestats.h"
+#include "renderahead.h"
+#include "settings.h"
+#include "xmpwrap.h"
+
+namespace
+{
+  /* Commands are rare: a seek or a settings change at a time. */
+  const std::size_t command_capacity = 16;
+
+  /* Waiting always has a timeout, in case a wakeup is missed. */
+  const std::chrono::milliseconds wait_limit(10);
+}
+
+/* The ring holds at least the requested number of frames, and never
+ * fewer than two packets, so that one can be rendered while the other
+ * is read.
+ */
+RenderAhead::RenderAhead(XMPWrap &xmp, const XMPSettings::Snapshot &settings, int frames) :
+  xmp(xmp),
+  audio(std::max((frames + packet_frames - 1) / packet_frames, 2)),
+  commands(command_capacity),
+  settings(settings)
+{
+  governor.reset(settings.interpolator);
+  thread = std::thread(&RenderAhead::run, this);
+}
+
+RenderAhead::~RenderAhead()
+{
+  Command command;
+
+  command.type = Command::stop;
+  send(command);
+  thread.join();
+}
+
+/* Return the next packet of audio, waiting for it if need be.  The
+ * previous packet is only released now, since the caller was still
+ * using it.
+ */
+XMPWrap::Frame RenderAhead::next()
+{
+  if(holding)
+  {
+    at_end = audio.front()->last;
+    audio.pop();
+    holding = false;
+    wake(renderer_waiting);
+  }
+
+  while(!at_end)
+  {
+    Packet *packet = audio.front();
+
+    if(packet == nullptr)
+    {
+      wait(reader_waiting, [this]() { return !audio.empty(); });
+    }
+    else if(packet->generation != generation || packet->n == 0)
+    {
+      /* Only the last packet can be empty. */
+      at_end = packet->generation == generation && packet->last;
+      audio.pop();
+      wake(renderer_waiting);
+    }
+    else
+    {
+      holding = true;
+      return XMPWrap::Frame(packet->n, packet->buf);
+    }
+  }
+
+  return XMPWrap::Frame(0, nullptr);
+}
+
+void RenderAhead::seek(int pos)
+{
+  Command command;
+
+  if(holding)
+  {
+    audio.pop();
+    holding = false;
+  }
+
+  at_end = false;
+
+  command.type = Command::seek;
+  command.position = pos;
+  command.generation = ++generation;
+  send(command);
+}
+
+void RenderAhead::apply(const XMPSettings::Snapshot &snapshot)
+{
+  Command command;
+
+  command.type = Command::apply;
+  command.settings = snapshot;
+  send(command);
+}
+
+/* Frames rendered but not yet read, to the nearest packet. */
+int RenderAhead::buffered() const
+{
+  return static_cast<int>(audio.size()) * packet_frames;
+}
+
+/* Commands are only dropped if the renderer has stopped, which only the
+ * destructor asks for, so retry until there's room.
+ */
+void RenderAhead::send(const Command &command)
+{
+  while(!commands.push(command))
+  {
+    wake(renderer_waiting);
+    std::this_thread::yield();
+  }
+
+  wake(renderer_waiting);
+}
+
+/* The fences pair with those in wait(): either the waiting side sees
+ * the change to the ring, or this side sees that it's waiting.
+ */
+void RenderAhead::wake(std::atomic<bool> &waiting)
+{
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  if(waiting.load(std::memory_order_relaxed))
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    cv.notify_all();
+  }
+}
+
+template <typename Predicate>
+void RenderAhead::wait(std::atomic<bool> &waiting, Predicate ready)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+
+  waiting.store(true, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  cv.wait_for(lock, wait_limit, ready);
+  waiting.store(false, std::memory_order_relaxed);
+}
+
+/* The rendering thread: carry out any commands, then render a packet if
+ * there's room for one and the module hasn't ended.
+ */
+void RenderAhead::run()
+{
+  while(true)
+  {
+    Command command;
+
+    while(commands.pop(command))
+    {
+      if(command.type == Command::stop)
+      {
+        return;
+      }
+
+      execute(command);
+    }
+
+    Packet *packet = ended ? nullptr : audio.back();
+    if(packet == nullptr)
+    {
+      wait(renderer_waiting, [this]() { return !commands.empty() || (!ended && !audio.full()); });
+      continue;
+    }
+
+    render_packet(*packet);
+    audio.push();
+    wake(reader_waiting);
+  }
+}
+
+/* The player fills the packet directly; only the last one of the module
+ * is short.  The block size setting only limits how much each read
+ * returns.  The governor, if enabled, is given the time taken to render
+ * each packet.
+ */
+void RenderAhead::render_packet(Packet &packet)
+{
+  bool collect_stats = settings.collect_stats;
+  std::int64_t start = collect_stats || settings.governor ? now() : 0;
+
+  packet.n = xmp.play_frame(packet.buf, sizeof packet.buf);
+
+  if(collect_stats)
+  {
+    DecodeStats::instance().record_frame(now() - start);
+  }
+
+  packet.generation = render_generation;
+  packet.last = packet.n < static_cast<int>(sizeof packet.buf);
+
+  if(packet.last)
+  {
+    ended = true;
+  }
+
+  if(settings.governor && packet.n != 0)
+  {
+    std::int64_t audio_ns = static_cast<std::int64_t>(packet.n / xmp.frame_size()) * 1000000000LL / xmp.rate();
+
+    if(governor.update(now() - start, audio_ns))
+    {
+      xmp.set_interpolator(governor.interpolator());
+    }
+  }
+}
+
+/* Settings are applied as the decoder would apply them. */
+void RenderAhead::execute(const Command &command)
+{
+  if(command.type == Command::seek)
+  {
+    std::int64_t start = settings.collect_stats ? now() : 0;
+
+    xmp.seek(command.position);
+
+    if(settings.collect_stats)
+    {
+      DecodeStats::instance().record_seek(now() - start);
+    }
+
+    render_generation = command.generation;
+    ended = false;
+  }
+  else if(command.type == Command::apply)
+  {
+    XMPSettings::apply(settings, command.settings, xmp, governor);
+    settings = command.settings;
+  }
+}
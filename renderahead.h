@@ -0,0 +1,123 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef QMMP_XMP_RENDERAHEAD_H
+#define QMMP_XMP_RENDERAHEAD_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "governor.h"
+#include "settings.h"
+#include "spscring.h"
+#include "xmpwrap.h"
+
+/* Renders on a thread of its own, ahead of the decoder, so that a slow
+ * tick is absorbed by the audio already rendered instead of delaying
+ * the output.  Audio is passed to the reader in fixed-size packets
+ * through one ring; seeks, settings and the request to stop go to the
+ * renderer through another.  The end of the module is marked by the
+ * last packet.
+ *
+ * Each seek starts a new generation, and packets of an earlier one
+ * (rendered before the renderer saw the seek) are dropped by the reader.
+ *
+ * While this exists, the player belongs to the rendering thread: the
+ * reader must not touch it.  The rings are lock-free; a mutex and
+ * condition variable are only used by a side that has to wait, and only
+ * taken by the other side when someone is waiting.
+ */
+class RenderAhead
+{
+  public:
+    RenderAhead(XMPWrap &, const XMPSettings::Snapshot &, int frames);
+    RenderAhead(const RenderAhead &) = delete;
+    RenderAhead &operator=(const RenderAhead &) = delete;
+    ~RenderAhead();
+
+    /* For the reader.  A frame stays valid until the next call to
+     * next() or seek().
+     */
+    XMPWrap::Frame next();
+    void seek(int);
+    void apply(const XMPSettings::Snapshot &);
+    int buffered() const;
+
+  private:
+    static const int packet_frames = 512;
+
+    struct Packet
+    {
+      unsigned int generation;
+      bool last;
+      int n;
+      std::int16_t buf[packet_frames * 2];
+    };
+
+    struct Command
+    {
+      enum Type { seek, apply, stop };
+
+      Type type;
+      int position;
+      unsigned int generation;
+      XMPSettings::Snapshot settings;
+    };
+
+    void run();
+    void render_packet(Packet &);
+    void execute(const Command &);
+    void send(const Command &);
+    void wake(std::atomic<bool> &);
+    template <typename Predicate> void wait(std::atomic<bool> &, Predicate);
+
+    XMPWrap &xmp;
+    SpscRing<Packet> audio;
+    SpscRing<Command> commands;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::atomic<bool> reader_waiting{false};
+    std::atomic<bool> renderer_waiting{false};
+
+    /* Reader side. */
+    unsigned int generation = 0;
+    bool holding = false;
+    bool at_end = false;
+
+    /* Renderer side. */
+    XMPSettings::Snapshot settings;
+    RenderGovernor governor;
+    unsigned int render_generation = 0;
+    bool ended = false;
+
+    std::thread thread;
+};
+
+#endif
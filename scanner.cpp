@@ -0,0 +1,300 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+
+#include "loudness.h"
+#include "metadatacache.h"
+#include "moduleinfo.h"
+#include "scanner.h"
+#include "xmpwrap.h"
+
+namespace
+{
+  /* Loudness doesn't depend much on the high frequencies, so analysis
+   * can save time by mixing at a low rate.
+   */
+  const int analysis_rate = 22050;
+
+  class Task : public QRunnable
+  {
+    public:
+      explicit Task(std::function<void()> f) : f(f) { }
+      void run() override { f(); }
+
+    private:
+      std::function<void()> f;
+  };
+}
+
+ModuleScanner::ModuleScanner(int threads, bool use_cache) : use_cache(use_cache)
+{
+  pool.setMaxThreadCount(threads);
+  analysis_pool.setMaxThreadCount(std::max(1, threads / 2));
+}
+
+ModuleScanner::~ModuleScanner()
+{
+  wait();
+}
+
+/* Deliberately never destroyed: workers may still be running when the
+ * plugin is torn down.  They use other singletons (the metadata and
+ * module caches, the context pool) which are destroyed at exit, though,
+ * so they are stopped when the application shuts down, which comes
+ * first.
+ */
+ModuleScanner &ModuleScanner::instance()
+{
+  static ModuleScanner *scanner = []() {
+    qAddPostRoutine([]() { ModuleScanner::instance().shutdown(); });
+    return new ModuleScanner();
+  }();
+
+  return *scanner;
+}
+
+/* Queue files to be loaded.  Files which are already queued are
+ * skipped, and the callback won't be called for them.
+ */
+void ModuleScanner::scan(const QStringList &paths, Callback callback)
+{
+  for(const QString &path : paths)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      if(in_flight.contains(path))
+      {
+        continue;
+      }
+
+      in_flight.insert(path);
+    }
+
+    pool.start(new Task([this, path, callback]() { run(path, callback); }));
+  }
+}
+
+/* Called on a cache miss for path.  A single miss might just be one file
+ * being added, so only on the second miss in the same directory is the
+ * rest of it (as selected by filters) queued.
+ */
+void ModuleScanner::prefetch_directory(const QString &path, const QStringList &filters)
+{
+  QFileInfo file_info(path);
+  QString directory = file_info.absolutePath();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if(++directory_misses[directory] != 2)
+    {
+      return;
+    }
+  }
+
+  QDir dir(directory);
+  QStringList paths;
+
+  for(const QString &name : dir.entryList(filters, QDir::Files | QDir::Readable, QDir::Name))
+  {
+    QString file = dir.filePath(name);
+
+    if(file != path)
+    {
+      paths << file;
+    }
+  }
+
+  scan(paths);
+}
+
+/* Get information about a single file, waiting for it if it's currently
+ * being scanned, and otherwise loading it on the calling thread.
+ */
+bool ModuleScanner::get(const QString &path, ModuleInfo &info)
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    finished.wait(lock, [this, &path]() { return !in_flight.contains(path); });
+  }
+
+  return load(path, info);
+}
+
+/* Queue files for loudness analysis, if they are in the metadata cache
+ * and haven't been analyzed yet.  The results go to the cache.
+ */
+void ModuleScanner::analyze(const QStringList &paths)
+{
+  for(const QString &path : paths)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      if(cancelled || analyzing.contains(path))
+      {
+        continue;
+      }
+
+      analyzing.insert(path);
+    }
+
+    analysis_pool.start(new Task([this, path]() {
+      ModuleInfo info;
+
+      /* On Linux, only this priority (SCHED_IDLE) has any effect. */
+      QThread::currentThread()->setPriority(QThread::IdlePriority);
+
+      if(!cancelled && MetaDataCache::instance().lookup(path, info) && !is_analyzed(info) && measure_loudness(path, info))
+      {
+        MetaDataCache::instance().insert(path, info);
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+      analyzing.remove(path);
+    }));
+  }
+}
+
+void ModuleScanner::wait()
+{
+  pool.waitForDone();
+  analysis_pool.waitForDone();
+}
+
+/* Abandon analysis, both queued and under way, and wait for all workers
+ * to finish.  No more analysis is accepted afterwards.
+ */
+void ModuleScanner::shutdown()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    cancelled = true;
+  }
+
+  analysis_pool.clear();
+  wait();
+}
+
+bool ModuleScanner::is_analyzed(const ModuleInfo &info)
+{
+  return std::all_of(info.sequences.begin(), info.sequences.end(),
+                     [](const ModuleInfo::Sequence &sequence) { return sequence.analyzed; });
+}
+
+/* Render each sequence with the default settings (other than the rate
+ * and interpolator, which barely affect loudness) and measure it.  This
+ * fails if analysis is cancelled partway through.
+ */
+bool ModuleScanner::measure_loudness(const QString &path, ModuleInfo &info)
+{
+  std::string filename = path.toUtf8().constData();
+
+  for(std::size_t i = 0; i < info.sequences.size(); i++)
+  {
+    try
+    {
+      XMPWrap xmp(filename, XMPWrap::default_panning_amplitude(), analysis_rate, i);
+      LoudnessMeter meter(xmp.rate());
+
+      xmp.set_interpolator(XMPWrap::interp_linear);
+
+      for(XMPWrap::Frame frame = xmp.play_frame(); frame.n != 0; frame = xmp.play_frame())
+      {
+        if(cancelled.load(std::memory_order_relaxed))
+        {
+          return false;
+        }
+
+        meter.add(static_cast<const std::int16_t *>(frame.buf), frame.n / xmp.frame_size());
+      }
+
+      info.sequences[i].loudness = meter.loudness();
+      info.sequences[i].peak = meter.peak();
+      info.sequences[i].analyzed = true;
+    }
+    catch(const XMPWrap::InvalidFile &)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool ModuleScanner::load(const QString &path, ModuleInfo &info)
+{
+  if(use_cache)
+  {
+    return MetaDataCache::instance().get(path, info);
+  }
+
+  try
+  {
+    XMPWrap xmp(path.toUtf8().constData());
+    info = xmp.info();
+  }
+  catch(const XMPWrap::InvalidFile &)
+  {
+    return false;
+  }
+
+  return true;
+}
+
+void ModuleScanner::run(const QString &path, const Callback &callback)
+{
+  ModuleInfo info;
+  bool ok = load(path, info);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    in_flight.remove(path);
+  }
+
+  finished.notify_all();
+
+  if(callback)
+  {
+    callback(path, ok ? &info : nullptr);
+  }
+}
@@ -0,0 +1,100 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef QMMP_XMP_SCANNER_H
+#define QMMP_XMP_SCANNER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+
+#include "moduleinfo.h"
+
+/* Loads modules on a pool of worker threads.  Every load happens in its
+ * own XMPWrap, and so its own libxmp context, so loads are independent
+ * and scale with the number of cores.
+ *
+ * Qmmp asks for playlist entries one file at a time, so the shared
+ * instance is used to read ahead: once a second file in a directory
+ * misses the metadata cache, the rest of the directory is scanned in the
+ * background, and later requests find their results in the cache (or
+ * wait for the load that's already underway).
+ *
+ * Loudness analysis, which renders every sequence of a module, happens
+ * on a separate, smaller pool of idle priority threads, so that it never
+ * holds up metadata loads or competes with playback.  Analysis can take
+ * seconds per module, so shutdown() abandons whatever is under way.
+ */
+class ModuleScanner
+{
+  public:
+    /* Called from a worker thread as soon as each file is done; the
+     * ModuleInfo is null if the file isn't a playable module.
+     */
+    typedef std::function<void(const QString &, const ModuleInfo *)> Callback;
+
+    explicit ModuleScanner(int = QThread::idealThreadCount(), bool = true);
+    ModuleScanner(const ModuleScanner &) = delete;
+    ModuleScanner &operator=(const ModuleScanner &) = delete;
+    ~ModuleScanner();
+
+    static ModuleScanner &instance();
+
+    void scan(const QStringList &, Callback = Callback());
+    void prefetch_directory(const QString &, const QStringList &);
+    bool get(const QString &, ModuleInfo &);
+    void analyze(const QStringList &);
+    void wait();
+    void shutdown();
+
+    static bool is_analyzed(const ModuleInfo &);
+
+  private:
+    bool load(const QString &, ModuleInfo &);
+    void run(const QString &, const Callback &);
+
+    bool measure_loudness(const QString &, ModuleInfo &);
+
+    QThreadPool pool;
+    QThreadPool analysis_pool;
+    bool use_cache;
+    std::mutex mutex;
+    std::condition_variable finished;
+    QSet<QString> in_flight;
+    QSet<QString> analyzing;
+    std::atomic<bool> cancelled{false};
+    QHash<QString, int> directory_misses;
+};
+
+#endif
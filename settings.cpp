@@ -0,0 +1,195 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <atomic>
+#include <mutex>
+
+#include <QSettings>
+#include <QString>
+#include <QStringList>
+
+#include <qmmp/effect.h>
+#include <qmmp/effectfactory.h>
+
+#include "governor.h"
+#include "settings.h"
+#include "xmpwrap.h"
+
+namespace
+{
+  std::mutex snapshot_mutex;
+  XMPSettings::Snapshot current_snapshot;
+
+  /* Zero means nothing has been published yet. */
+  std::atomic<unsigned int> current_generation(0);
+}
+
+XMPSettings::Snapshot XMPSettings::snapshot(unsigned int *generation)
+{
+  if(current_generation.load(std::memory_order_acquire) == 0)
+  {
+    XMPSettings settings;
+    settings.publish();
+  }
+
+  std::lock_guard<std::mutex> lock(snapshot_mutex);
+
+  if(generation != nullptr)
+  {
+    *generation = current_generation.load(std::memory_order_relaxed);
+  }
+
+  return current_snapshot;
+}
+
+unsigned int XMPSettings::generation()
+{
+  return current_generation.load(std::memory_order_acquire);
+}
+
+void XMPSettings::publish()
+{
+  Snapshot snapshot;
+
+  snapshot.interpolator = get_interpolator();
+  snapshot.stereo_separation = get_stereo_separation();
+  snapshot.panning_amplitude = get_panning_amplitude();
+  snapshot.use_filename = get_use_filename();
+  snapshot.output_format = get_output_format();
+  snapshot.mixing_rate = mixing_rate(get_rate());
+  snapshot.collect_stats = get_collect_stats();
+  snapshot.analyze_loudness = get_analyze_loudness();
+  snapshot.governor = get_governor();
+  snapshot.block_size = get_block_size();
+  snapshot.render_ahead = get_render_ahead();
+  snapshot.render_ahead_depth = get_render_ahead_depth();
+
+  XMPWrap::ChannelSet solo;
+  parse_channels(get_muted_channels(), &snapshot.muted_channels);
+  parse_channels(get_solo_channels(), &solo);
+  if(solo.any())
+  {
+    snapshot.muted_channels |= ~solo;
+  }
+
+  std::lock_guard<std::mutex> lock(snapshot_mutex);
+  current_snapshot = snapshot;
+  current_generation.fetch_add(1, std::memory_order_release);
+}
+
+/* Bring a player from one snapshot's settings to another's, changing
+ * only what differs.  The governor starts over at the new interpolator;
+ * switching it off restores the user's interpolator.  The rest of the
+ * settings are only used by the decoder itself.
+ */
+void XMPSettings::apply(const Snapshot &old, const Snapshot &snapshot, XMPWrap &xmp, RenderGovernor &governor)
+{
+  if(snapshot.interpolator != old.interpolator || snapshot.governor != old.governor)
+  {
+    xmp.set_interpolator(snapshot.interpolator);
+    governor.reset(snapshot.interpolator);
+  }
+
+  if(snapshot.stereo_separation != old.stereo_separation)
+  {
+    xmp.set_stereo_separation(snapshot.stereo_separation);
+  }
+
+  if(snapshot.muted_channels != old.muted_channels)
+  {
+    xmp.set_muted_channels(snapshot.muted_channels);
+  }
+}
+
+/* Parse a channel list (see get_muted_channels()), returning whether it
+ * is valid.  An empty list is valid, and names no channels.
+ */
+bool XMPSettings::parse_channels(const QString &list, XMPWrap::ChannelSet *channels)
+{
+  XMPWrap::ChannelSet parsed;
+
+  for(const QString &item : list.split(','))
+  {
+    if(item.trimmed().isEmpty())
+    {
+      continue;
+    }
+
+    QStringList range = item.split('-');
+    bool ok_first, ok_last = true;
+    int first = range[0].trimmed().toInt(&ok_first);
+    int last = range.size() == 2 ? range[1].trimmed().toInt(&ok_last) : first;
+
+    if(range.size() > 2 || !ok_first || !ok_last || first < 1 || last < first || last > int(parsed.size()))
+    {
+      return false;
+    }
+
+    for(int i = first; i <= last; i++)
+    {
+      parsed.set(i - 1);
+    }
+  }
+
+  if(channels != nullptr)
+  {
+    *channels = parsed;
+  }
+
+  return true;
+}
+
+/* Resolve a configured rate to the rate libxmp should mix at.  Qmmp has
+ * no notion of an output device rate as such; if its sample rate
+ * converter is enabled, though, everything ends up at the converter's
+ * rate, so mix at that rate directly and the converter has nothing to
+ * do.  Otherwise fall back to the default.  This is done when settings
+ * are published rather than for each track, so a change to the
+ * converter is picked up the next time they are.
+ */
+int XMPSettings::mixing_rate(int rate)
+{
+  if(rate != rate_auto)
+  {
+    return rate;
+  }
+
+  EffectFactory *src = Effect::findFactory("srconverter");
+  if(src != nullptr && Effect::isEnabled(src))
+  {
+    /* The converter's settings are outside this plugin's group. */
+    settings->endGroup();
+    int src_rate = settings->value("SRC/sample_rate", 48000).toInt();
+    settings->beginGroup("cas-xmp-plugin");
+
+    if(XMPWrap::is_valid_rate(src_rate))
+    {
+      return src_rate;
+    }
+  }
+
+  return XMPWrap::default_rate();
+}
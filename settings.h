@@ -28,17 +28,62 @@
 #define QMMP_XMP_SETTINGS_H
 
 #include <QList>
+#include <QObject>
 #include <QPair>
 #include <QSettings>
 #include <QString>
 
 #include <qmmp/qmmp.h>
 
+#include "modulecache.h"
 #include "xmpwrap.h"
 
+class RenderGovernor;
+
 class XMPSettings
 {
   public:
+    /* The values the player needs, as last published by publish().  A
+     * decoder keeps its own copy and only refreshes it when generation()
+     * changes, so reading settings never touches QSettings (or takes a
+     * lock) on the decoding thread.
+     */
+    struct Snapshot
+    {
+      int interpolator;
+      int stereo_separation;
+      int panning_amplitude;
+      bool use_filename;
+      int output_format;
+      /* The configured rate, with the automatic setting resolved. */
+      int mixing_rate;
+      bool collect_stats;
+      bool analyze_loudness;
+      bool governor;
+      int block_size;
+      bool render_ahead;
+      int render_ahead_depth;
+
+      /* With any solo channels, everything else is muted too. */
+      XMPWrap::ChannelSet muted_channels;
+    };
+
+    /* libxmp always mixes to 16-bit integers; the float format is
+     * converted by the decoder so the rest of Qmmp's chain can skip its
+     * own conversion.
+     */
+    static const int format_s16 = 0;
+    static const int format_float = 1;
+
+    static Snapshot snapshot(unsigned int * = nullptr);
+    static unsigned int generation();
+    void publish();
+    static void apply(const Snapshot &, const Snapshot &, XMPWrap &, RenderGovernor &);
+
+    static const int rate_auto = 0;
+
+    static bool parse_channels(const QString &, XMPWrap::ChannelSet * = nullptr);
+
     XMPSettings() : settings(new QSettings(Qmmp::configFile(), QSettings::IniFormat))
     {
       for(const XMPWrap::Interpolator &interpolator : XMPWrap::get_interpolators())
@@ -46,6 +91,21 @@ class XMPSettings
         interpolators.append(QPair<QString, int>(QString::fromStdString(interpolator.name), interpolator.value));
       }
 
+      output_formats.append(QPair<QString, int>(QObject::tr("16-bit integer"), format_s16));
+      output_formats.append(QPair<QString, int>(QObject::tr("32-bit float"), format_float));
+
+      rates.append(QPair<QString, int>(QObject::tr("Automatic (match output)"), rate_auto));
+      for(int rate : XMPWrap::get_rates())
+      {
+        rates.append(QPair<QString, int>(QObject::tr("%1 Hz").arg(rate), rate));
+      }
+
+      block_sizes.append(QPair<QString, int>(QObject::tr("Off"), 0));
+      for(int size : XMPWrap::get_block_sizes())
+      {
+        block_sizes.append(QPair<QString, int>(QObject::tr("%1 frames").arg(size), size));
+      }
+
       settings->beginGroup("cas-xmp-plugin");
     }
 
@@ -139,12 +199,265 @@ class XMPSettings
       return false;
     }
 
+    const QList<QPair<QString, int>> get_output_formats()
+    {
+      return output_formats;
+    }
+
+    static bool is_valid_output_format(int format)
+    {
+      return format == format_s16 || format == format_float;
+    }
+
+    int get_output_format()
+    {
+      int format = settings->value("output_format", default_output_format()).toInt();
+
+      return is_valid_output_format(format) ? format : default_output_format();
+    }
+
+    void set_output_format(int format)
+    {
+      if(is_valid_output_format(format))
+      {
+        settings->setValue("output_format", format);
+      }
+    }
+
+    int default_output_format()
+    {
+      return format_s16;
+    }
+
+    const QList<QPair<QString, int>> get_rates()
+    {
+      return rates;
+    }
+
+    static bool is_valid_rate(int rate)
+    {
+      return rate == rate_auto || XMPWrap::is_valid_rate(rate);
+    }
+
+    int get_rate()
+    {
+      int rate = settings->value("sample_rate", default_rate()).toInt();
+
+      return is_valid_rate(rate) ? rate : default_rate();
+    }
+
+    void set_rate(int rate)
+    {
+      if(is_valid_rate(rate))
+      {
+        settings->setValue("sample_rate", rate);
+      }
+    }
+
+    int default_rate()
+    {
+      return XMPWrap::default_rate();
+    }
+
+    /* In megabytes. */
+    static bool is_valid_cache_size(int size)
+    {
+      return size >= 0 && size <= 1024;
+    }
+
+    int get_cache_size()
+    {
+      int size = settings->value("cache_size", default_cache_size()).toInt();
+
+      return is_valid_cache_size(size) ? size : default_cache_size();
+    }
+
+    void set_cache_size(int size)
+    {
+      if(is_valid_cache_size(size))
+      {
+        settings->setValue("cache_size", size);
+      }
+    }
+
+    int default_cache_size()
+    {
+      return ModuleCache::default_budget / (1024 * 1024);
+    }
+
+    /* The module cache's budget isn't part of the snapshot: it's set when
+     * the plugin is loaded and whenever the settings dialog is accepted.
+     */
+    void apply_cache_size()
+    {
+      ModuleCache::instance().set_budget(qint64(get_cache_size()) * 1024 * 1024);
+    }
+
+    bool get_collect_stats()
+    {
+      return settings->value("collect_stats", default_collect_stats()).toBool();
+    }
+
+    void set_collect_stats(bool collect)
+    {
+      settings->setValue("collect_stats", collect);
+    }
+
+    bool default_collect_stats()
+    {
+      return false;
+    }
+
+    bool get_analyze_loudness()
+    {
+      return settings->value("analyze_loudness", default_analyze_loudness()).toBool();
+    }
+
+    void set_analyze_loudness(bool analyze)
+    {
+      settings->setValue("analyze_loudness", analyze);
+    }
+
+    bool default_analyze_loudness()
+    {
+      return false;
+    }
+
+    const QList<QPair<QString, int>> get_block_sizes()
+    {
+      return block_sizes;
+    }
+
+    int get_block_size()
+    {
+      int size = settings->value("block_size", default_block_size()).toInt();
+
+      return XMPWrap::is_valid_block_size(size) ? size : default_block_size();
+    }
+
+    void set_block_size(int size)
+    {
+      if(XMPWrap::is_valid_block_size(size))
+      {
+        settings->setValue("block_size", size);
+      }
+    }
+
+    int default_block_size()
+    {
+      return 0;
+    }
+
+    bool get_render_ahead()
+    {
+      return settings->value("render_ahead", default_render_ahead()).toBool();
+    }
+
+    void set_render_ahead(bool render_ahead)
+    {
+      settings->setValue("render_ahead", render_ahead);
+    }
+
+    bool default_render_ahead()
+    {
+      return false;
+    }
+
+    /* In milliseconds. */
+    static bool is_valid_render_ahead_depth(int depth)
+    {
+      return depth >= 20 && depth <= 2000;
+    }
+
+    int get_render_ahead_depth()
+    {
+      int depth = settings->value("render_ahead_depth", default_render_ahead_depth()).toInt();
+
+      return is_valid_render_ahead_depth(depth) ? depth : default_render_ahead_depth();
+    }
+
+    void set_render_ahead_depth(int depth)
+    {
+      if(is_valid_render_ahead_depth(depth))
+      {
+        settings->setValue("render_ahead_depth", depth);
+      }
+    }
+
+    int default_render_ahead_depth()
+    {
+      return 200;
+    }
+
+    bool get_governor()
+    {
+      return settings->value("governor", default_governor()).toBool();
+    }
+
+    void set_governor(bool governor)
+    {
+      settings->setValue("governor", governor);
+    }
+
+    bool default_governor()
+    {
+      return false;
+    }
+
+    /* Channel lists are as typed into the dialog: channel numbers (from
+     * 1) and ranges, separated by commas, such as "1, 4-6".
+     */
+    QString get_muted_channels()
+    {
+      QString channels = settings->value("muted_channels", default_muted_channels()).toString();
+
+      return parse_channels(channels) ? channels : default_muted_channels();
+    }
+
+    void set_muted_channels(const QString &channels)
+    {
+      if(parse_channels(channels))
+      {
+        settings->setValue("muted_channels", channels.trimmed());
+      }
+    }
+
+    QString default_muted_channels()
+    {
+      return "";
+    }
+
+    QString get_solo_channels()
+    {
+      QString channels = settings->value("solo_channels", default_solo_channels()).toString();
+
+      return parse_channels(channels) ? channels : default_solo_channels();
+    }
+
+    void set_solo_channels(const QString &channels)
+    {
+      if(parse_channels(channels))
+      {
+        settings->setValue("solo_channels", channels.trimmed());
+      }
+    }
+
+    QString default_solo_channels()
+    {
+      return "";
+    }
+
   private:
     XMPSettings(const XMPSettings &);
     XMPSettings &operator=(const XMPSettings &);
 
+    int mixing_rate(int);
+
     QSettings *settings;
     QList<QPair<QString, int>> interpolators;
+    QList<QPair<QString, int>> output_formats;
+    QList<QPair<QString, int>> rates;
+    QList<QPair<QString, int>> block_sizes;
 };
 
 #endif
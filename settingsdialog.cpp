@@ -25,11 +25,15 @@
  */
 
 #include <QDialog>
+#include <QMessageBox>
 #include <QPair>
 #include <QString>
 #include <QVariant>
 #include <QWidget>
 
+#include <qmmp/qmmp.h>
+
+#include "decodestats.h"
 #include "settingsdialog.h"
 
 SettingsDialog::SettingsDialog(QWidget *parent) : QDialog(parent)
@@ -44,18 +48,68 @@ SettingsDialog::SettingsDialog(QWidget *parent) : QDialog(parent)
 
   set_interpolator(settings.get_interpolator());
 
+  for(const auto &format : settings.get_output_formats())
+  {
+    ui.format_combo->addItem(format.first, format.second);
+  }
+
+  set_output_format(settings.get_output_format());
+
+  for(const auto &rate : settings.get_rates())
+  {
+    ui.rate_combo->addItem(rate.first, rate.second);
+  }
+
+  set_rate(settings.get_rate());
+
+  for(const auto &size : settings.get_block_sizes())
+  {
+    ui.block_combo->addItem(size.first, size.second);
+  }
+
+  set_block_size(settings.get_block_size());
+
   ui.stereo_separation->setSliderPosition(settings.get_stereo_separation());
   ui.panning_amplitude->setSliderPosition(settings.get_panning_amplitude());
 
+  ui.cache_size->setValue(settings.get_cache_size());
+
   ui.use_filename->setChecked(settings.get_use_filename());
+  ui.collect_stats->setChecked(settings.get_collect_stats());
+  ui.analyze_loudness->setChecked(settings.get_analyze_loudness());
+  ui.governor->setChecked(settings.get_governor());
+  ui.render_ahead->setChecked(settings.get_render_ahead());
+  ui.render_ahead_depth->setValue(settings.get_render_ahead_depth());
+
+  ui.muted_channels->setText(settings.get_muted_channels());
+  ui.solo_channels->setText(settings.get_solo_channels());
 }
 
 void SettingsDialog::accept()
 {
+  if(!XMPSettings::parse_channels(ui.muted_channels->text()) || !XMPSettings::parse_channels(ui.solo_channels->text()))
+  {
+    QMessageBox::warning(this, tr("Channels"), tr("Channels must be listed as numbers from 1 to %1 or ranges, such as \"1, 4-6\".").arg(XMP_MAX_CHANNELS));
+    return;
+  }
+
   settings.set_interpolator(ui.interpolate_combo->itemData(ui.interpolate_combo->currentIndex()).toInt());
   settings.set_stereo_separation(ui.stereo_separation->value());
   settings.set_panning_amplitude(ui.panning_amplitude->value());
   settings.set_use_filename(ui.use_filename->isChecked());
+  settings.set_output_format(ui.format_combo->itemData(ui.format_combo->currentIndex()).toInt());
+  settings.set_rate(ui.rate_combo->itemData(ui.rate_combo->currentIndex()).toInt());
+  settings.set_cache_size(ui.cache_size->value());
+  settings.apply_cache_size();
+  settings.set_collect_stats(ui.collect_stats->isChecked());
+  settings.set_analyze_loudness(ui.analyze_loudness->isChecked());
+  settings.set_governor(ui.governor->isChecked());
+  settings.set_render_ahead(ui.render_ahead->isChecked());
+  settings.set_render_ahead_depth(ui.render_ahead_depth->value());
+  settings.set_block_size(ui.block_combo->itemData(ui.block_combo->currentIndex()).toInt());
+  settings.set_muted_channels(ui.muted_channels->text());
+  settings.set_solo_channels(ui.solo_channels->text());
+  settings.publish();
 
   QDialog::accept();
 }
@@ -66,6 +120,31 @@ void SettingsDialog::restore_defaults()
   ui.stereo_separation->setSliderPosition(settings.default_stereo_separation());
   ui.panning_amplitude->setSliderPosition(settings.default_panning_amplitude());
   ui.use_filename->setChecked(settings.default_use_filename());
+  set_output_format(settings.default_output_format());
+  set_rate(settings.default_rate());
+  ui.cache_size->setValue(settings.default_cache_size());
+  ui.collect_stats->setChecked(settings.default_collect_stats());
+  ui.analyze_loudness->setChecked(settings.default_analyze_loudness());
+  ui.governor->setChecked(settings.default_governor());
+  ui.render_ahead->setChecked(settings.default_render_ahead());
+  ui.render_ahead_depth->setValue(settings.default_render_ahead_depth());
+  set_block_size(settings.default_block_size());
+  ui.muted_channels->setText(settings.default_muted_channels());
+  ui.solo_channels->setText(settings.default_solo_channels());
+}
+
+void SettingsDialog::save_stats()
+{
+  QString filename = Qmmp::configDir() + "/cas-xmp-stats.txt";
+
+  if(DecodeStats::instance().save(filename))
+  {
+    QMessageBox::information(this, tr("Decoder Statistics"), tr("Statistics saved to %1.").arg(filename));
+  }
+  else
+  {
+    QMessageBox::warning(this, tr("Decoder Statistics"), tr("Unable to save statistics to %1.").arg(filename));
+  }
 }
 
 void SettingsDialog::set_interpolator(int interpolator)
@@ -76,3 +155,30 @@ void SettingsDialog::set_interpolator(int interpolator)
     ui.interpolate_combo->setCurrentIndex(i);
   }
 }
+
+void SettingsDialog::set_output_format(int format)
+{
+  int i = ui.format_combo->findData(format);
+  if(i != -1)
+  {
+    ui.format_combo->setCurrentIndex(i);
+  }
+}
+
+void SettingsDialog::set_rate(int rate)
+{
+  int i = ui.rate_combo->findData(rate);
+  if(i != -1)
+  {
+    ui.rate_combo->setCurrentIndex(i);
+  }
+}
+
+void SettingsDialog::set_block_size(int size)
+{
+  int i = ui.block_combo->findData(size);
+  if(i != -1)
+  {
+    ui.block_combo->setCurrentIndex(i);
+  }
+}
@@ -43,12 +43,16 @@ class SettingsDialog : public QDialog
   public slots:
     virtual void accept();
     void restore_defaults();
+    void save_stats();
 
   private:
     Ui::SettingsDialog ui;
     XMPSettings settings;
 
     void set_interpolator(int);
+    void set_output_format(int);
+    void set_rate(int);
+    void set_block_size(int);
 };
 
 #endif
@@ -0,0 +1,139 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <cstddef>
+
+#include "signature.h"
+
+namespace
+{
+  struct Signature
+  {
+    std::size_t offset;
+    const char *magic;
+    std::size_t length;
+  };
+
+  /* In magic strings, '#' matches any decimal digit and '?' any byte.
+   * Three-letter tags are followed by the version bytes (or, for
+   * Megatracker, the further tag) that libxmp's loaders check, since
+   * three letters alone turn up in other files too often.
+   */
+  constexpr Signature signatures[] = {
+    { 0, "Extended Module: ", 17 },        /* XM */
+    { 0, "IMPM", 4 },                      /* IT */
+    { 44, "SCRM", 4 },                     /* S3M */
+    { 44, "PTMF", 4 },                     /* PTM */
+    { 0, "MTM\x10", 4 },                   /* MTM */
+    { 0, "MMD0", 4 },                      /* MED */
+    { 0, "MMD1", 4 },
+    { 0, "MMD2", 4 },
+    { 0, "MMD3", 4 },
+    { 0, "OKTASONG", 8 },                  /* Oktalyzer */
+    { 0, "FAR\xfe", 4 },                   /* Farandole */
+    { 20, "!Scream!", 8 },                 /* STM */
+    { 20, "BMOD2STM", 8 },
+    { 0, "MAS_UTrack_V00", 14 },           /* ULT */
+    { 0, "DBM0", 4 },                      /* DigiBooster Pro */
+    { 0, "DIGI Booster module", 19 },      /* DigiBooster */
+    { 0, "AMF\x01", 4 },                   /* DSMI AMF */
+    { 0, "AMF\x08", 4 },
+    { 0, "AMF\x09", 4 },
+    { 0, "AMF\x0a", 4 },
+    { 0, "AMF\x0b", 4 },
+    { 0, "AMF\x0c", 4 },
+    { 0, "AMF\x0d", 4 },
+    { 0, "AMF\x0e", 4 },
+    { 0, "ASYLUM Music Format", 19 },      /* Asylum AMF */
+    { 0, "DMDL", 4 },                      /* Digitrakker */
+    { 60, "IM10", 4 },                     /* Imago Orpheus */
+    { 0, "GDM\xfe", 4 },                   /* General DigiMusic */
+    { 0, "RTMM", 4 },                      /* Real Tracker */
+    { 0, "MUSE\xde\xad\xbe\xaf", 8 },      /* Galaxy (J2B) */
+    { 0, "MUSE\xde\xad\xba\xbe", 8 },
+    { 0, "PSM ", 4 },                      /* Epic MegaGames MASI */
+    { 0, "PSM\xfe", 4 },
+    { 0, "Liquid Module:", 14 },           /* Liquid Tracker */
+    { 8, "EMOD", 4 },                      /* Quadra Composer */
+    { 0, "Funk", 4 },                      /* Funktracker */
+    { 0, "RAD by REALiTY!!", 16 },         /* Reality AdLib Tracker */
+    { 0, "MGT?\xbdMCS", 8 },               /* Megatracker */
+    { 0, "\xc1\x83\x2a\x9e", 4 },          /* Unreal package */
+    { 1080, "M.K.", 4 },                   /* Protracker and relatives */
+    { 1080, "M!K!", 4 },
+    { 1080, "M&K!", 4 },
+    { 1080, "N.T.", 4 },
+    { 1080, "FLT4", 4 },
+    { 1080, "FLT8", 4 },
+    { 1080, "CD81", 4 },
+    { 1080, "OKTA", 4 },
+    { 1080, "OCTA", 4 },
+    { 1080, "#CHN", 4 },
+    { 1080, "##CH", 4 },
+    { 1080, "TDZ#", 4 },
+    { 1080, "FA0#", 4 },
+  };
+
+  bool matches(const Signature &signature, const unsigned char *buf, std::size_t size)
+  {
+    if(signature.offset + signature.length > size)
+    {
+      return false;
+    }
+
+    buf += signature.offset;
+
+    for(std::size_t i = 0; i < signature.length; i++)
+    {
+      unsigned char c = signature.magic[i];
+
+      if(c == '?')
+      {
+        continue;
+      }
+
+      if(c == '#' ? (buf[i] < '0' || buf[i] > '9') : buf[i] != c)
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+}
+
+bool has_module_signature(const unsigned char *buf, std::size_t size)
+{
+  for(const Signature &signature : signatures)
+  {
+    if(matches(signature, buf, size))
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
@@ -0,0 +1,142 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef QMMP_XMP_SPSCRING_H
+#define QMMP_XMP_SPSCRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/* A fixed-size ring for exactly one producer thread and one consumer
+ * thread, with no locking.  Items are used in place: the producer fills
+ * the slot from back() and publishes it with push(); the consumer reads
+ * the slot from front() and releases it with pop().  back() and front()
+ * return null when the ring is full or empty, respectively.
+ *
+ * The indices count up forever (wrapping a size_t takes a while) and are
+ * reduced modulo the capacity, so every slot is usable.
+ */
+template <typename T>
+class SpscRing
+{
+  public:
+    explicit SpscRing(std::size_t capacity) : slots_(capacity > 0 ? capacity : 1) { }
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    T *back()
+    {
+      std::size_t tail = tail_.load(std::memory_order_relaxed);
+
+      if(tail - head_.load(std::memory_order_acquire) == slots_.size())
+      {
+        return nullptr;
+      }
+
+      return &slots_[tail % slots_.size()];
+    }
+
+    void push()
+    {
+      tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    bool push(const T &item)
+    {
+      T *slot = back();
+
+      if(slot == nullptr)
+      {
+        return false;
+      }
+
+      *slot = item;
+      push();
+
+      return true;
+    }
+
+    T *front()
+    {
+      std::size_t head = head_.load(std::memory_order_relaxed);
+
+      if(head == tail_.load(std::memory_order_acquire))
+      {
+        return nullptr;
+      }
+
+      return &slots_[head % slots_.size()];
+    }
+
+    void pop()
+    {
+      head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    bool pop(T &item)
+    {
+      T *slot = front();
+
+      if(slot == nullptr)
+      {
+        return false;
+      }
+
+      item = *slot;
+      pop();
+
+      return true;
+    }
+
+    /* Either side may call these; the answer may be stale by the time
+     * it's used.  The head is read first, since it never passes the tail.
+     */
+    std::size_t size() const
+    {
+      std::size_t head = head_.load(std::memory_order_acquire);
+
+      return tail_.load(std::memory_order_acquire) - head;
+    }
+
+    bool empty() const { return size() == 0; }
+    bool full() const { return size() >= slots_.size(); }
+    std::size_t capacity() const { return slots_.size(); }
+
+  private:
+    std::vector<T> slots_;
+
+    /* Keep the indices, each written by only one side, on separate cache
+     * lines.
+     */
+    char pad0_[64];
+    std::atomic<std::size_t> head_{0};
+    char pad1_[64];
+    std::atomic<std::size_t> tail_{0};
+    char pad2_[64];
+};
+
+#endif
@@ -0,0 +1,435 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Batch rendering.  Module lengths vary enormously (ten seconds to forty
+ * minutes is normal), so to keep every core busy until the end:
+ *
+ * - Modules are dealt out, largest file first, to one queue per worker.
+ *   File size stands in for duration, which would take a load of each
+ *   module to learn; the order only needs to be roughly right.  Each
+ *   worker takes the largest job left in its own queue; a worker whose
+ *   queue is empty steals the smallest job from another's, so the long
+ *   jobs start early and the short ones fill in the gaps at the end.
+ * - Rendered audio is handed to a writer thread in large chunks, so a
+ *   slow disk doesn't hold up rendering until a fair amount of audio is
+ *   waiting to be written.
+ *
+ * Each worker's XMPWrap has a libxmp context of its own.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QString>
+
+#include "batch.h"
+#include "render.h"
+#include "xmpwrap.h"
+
+namespace
+{
+  /* Audio is passed to the writer in chunks of this size, and rendering
+   * waits once this much is queued.
+   */
+  const std::size_t chunk_size = 1 << 20;
+  const std::size_t max_queued = 64 << 20;
+
+  struct Job
+  {
+    std::string module;
+    std::string output;
+    long long size;
+  };
+
+  /* One output file, as seen by the writer thread. */
+  struct Output
+  {
+    explicit Output(const std::string &filename) : filename(filename) { }
+
+    std::string filename;
+    std::FILE *file = nullptr;
+
+    /* Read by the renderer, so it can give up early. */
+    std::atomic<bool> ok{true};
+  };
+
+  class Writer
+  {
+    public:
+      Writer() : thread(&Writer::run, this) { }
+
+      ~Writer()
+      {
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          done = true;
+        }
+        ready.notify_all();
+        thread.join();
+      }
+
+      void open(const std::shared_ptr<Output> &output) { push(Chunk(Chunk::open, output)); }
+      void write(const std::shared_ptr<Output> &output, std::vector<unsigned char> &&data) { push(Chunk(Chunk::write, output, std::move(data))); }
+
+      /* The header, if given, replaces the start of the file. */
+      void close(const std::shared_ptr<Output> &output, std::vector<unsigned char> &&header) { push(Chunk(Chunk::close, output, std::move(header))); }
+
+      /* Wait for everything to be written, which is when an output's ok
+       * flag becomes final.
+       */
+      void drain()
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        space.wait(lock, [this] { return chunks.empty() && !busy; });
+      }
+
+    private:
+      struct Chunk
+      {
+        enum Kind { open, write, close };
+
+        Chunk(Kind kind, const std::shared_ptr<Output> &output, std::vector<unsigned char> &&data = std::vector<unsigned char>()) :
+          kind(kind), output(output), data(std::move(data)) { }
+
+        Kind kind;
+        std::shared_ptr<Output> output;
+        std::vector<unsigned char> data;
+      };
+
+      void push(Chunk &&chunk)
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        space.wait(lock, [this] { return queued < max_queued; });
+        queued += chunk.data.size();
+        chunks.push_back(std::move(chunk));
+        ready.notify_one();
+      }
+
+      void run()
+      {
+        while(true)
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+
+          ready.wait(lock, [this] { return !chunks.empty() || done; });
+          if(chunks.empty())
+          {
+            return;
+          }
+
+          Chunk chunk = std::move(chunks.front());
+          chunks.pop_front();
+          busy = true;
+          lock.unlock();
+
+          handle(chunk);
+
+          lock.lock();
+          queued -= chunk.data.size();
+          busy = false;
+          space.notify_all();
+        }
+      }
+
+      void handle(const Chunk &chunk)
+      {
+        Output &output = *chunk.output;
+
+        switch(chunk.kind)
+        {
+          case Chunk::open:
+            output.file = std::fopen(output.filename.c_str(), "wb");
+            output.ok = output.file != nullptr;
+            break;
+
+          case Chunk::write:
+            if(output.ok && std::fwrite(chunk.data.data(), 1, chunk.data.size(), output.file) != chunk.data.size())
+            {
+              output.ok = false;
+            }
+            break;
+
+          case Chunk::close:
+            if(output.file != nullptr)
+            {
+              if(output.ok && !chunk.data.empty())
+              {
+                output.ok = std::fseek(output.file, 0, SEEK_SET) == 0 &&
+                            std::fwrite(chunk.data.data(), 1, chunk.data.size(), output.file) == chunk.data.size();
+              }
+              if(std::fclose(output.file) != 0)
+              {
+                output.ok = false;
+              }
+              output.file = nullptr;
+            }
+            break;
+        }
+      }
+
+      std::mutex mutex;
+      std::condition_variable ready;
+      std::condition_variable space;
+      std::deque<Chunk> chunks;
+      std::size_t queued = 0;
+      bool busy = false;
+      bool done = false;
+      std::thread thread;
+  };
+
+  class JobQueues
+  {
+    public:
+      /* The jobs must be sorted largest first. */
+      JobQueues(const std::vector<Job> &jobs, int workers)
+      {
+        for(int i = 0; i < workers; i++)
+        {
+          queues.push_back(std::unique_ptr<Queue>(new Queue));
+        }
+
+        for(std::size_t i = 0; i < jobs.size(); i++)
+        {
+          queues[i % workers]->jobs.push_back(jobs[i]);
+        }
+      }
+
+      bool next(int worker, Job &job)
+      {
+        for(std::size_t i = 0; i < queues.size(); i++)
+        {
+          Queue &queue = *queues[(worker + i) % queues.size()];
+          std::lock_guard<std::mutex> lock(queue.mutex);
+
+          if(!queue.jobs.empty())
+          {
+            if(i == 0)
+            {
+              job = queue.jobs.front();
+              queue.jobs.pop_front();
+            }
+            else
+            {
+              job = queue.jobs.back();
+              queue.jobs.pop_back();
+            }
+
+            return true;
+          }
+        }
+
+        return false;
+      }
+
+    private:
+      struct Queue
+      {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+      };
+
+      std::vector<std::unique_ptr<Queue>> queues;
+  };
+}
+
+static std::string base_name(const std::string &path)
+{
+  std::size_t slash = path.find_last_of('/');
+  std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+
+  return name.empty() ? "module" : name;
+}
+
+/* Output files are named after the modules, with a number added where
+ * two modules (in different directories) have the same name.
+ */
+static std::vector<std::string> output_names(const std::vector<std::string> &modules, const std::string &directory, const char *extension)
+{
+  std::vector<std::string> names;
+  std::set<std::string> used;
+
+  for(const std::string &module : modules)
+  {
+    std::string base = directory + "/" + base_name(module);
+    std::string name = base + extension;
+
+    for(int n = 2; used.count(name) != 0; n++)
+    {
+      name = base + "-" + std::to_string(n) + extension;
+    }
+
+    used.insert(name);
+    names.push_back(name);
+  }
+
+  return names;
+}
+
+/* Run f(i) for i in [0, n) on the given number of threads. */
+template<typename F>
+static void parallel_for(int n, int threads, F f)
+{
+  std::atomic<int> next(0);
+  std::vector<std::thread> workers;
+
+  for(int t = 0; t < threads; t++)
+  {
+    workers.push_back(std::thread([&] {
+      for(int i = next++; i < n; i = next++)
+      {
+        f(i);
+      }
+    }));
+  }
+
+  for(std::thread &worker : workers)
+  {
+    worker.join();
+  }
+}
+
+int render_batch(const std::vector<std::string> &modules, const RenderOptions &options, const std::string &directory, int threads)
+{
+  QElapsedTimer timer;
+  std::vector<std::string> outputs = output_names(modules, directory, options.wav ? ".wav" : ".raw");
+  std::vector<Job> jobs;
+  std::atomic<int> failed(0);
+  std::atomic<long long> audio_bytes(0);
+
+  timer.start();
+
+  /* A missing file sorts last, and the worker reports it. */
+  for(std::size_t i = 0; i < modules.size(); i++)
+  {
+    jobs.push_back(Job{modules[i], outputs[i], QFileInfo(QString::fromStdString(modules[i])).size()});
+  }
+
+  std::stable_sort(jobs.begin(), jobs.end(), [](const Job &a, const Job &b) { return a.size > b.size; });
+
+  {
+    Writer writer;
+    JobQueues queues(jobs, threads);
+    std::vector<std::pair<std::string, std::shared_ptr<Output>>> written;
+    std::mutex written_mutex;
+
+    parallel_for(threads, threads, [&](int worker) {
+      Job job;
+
+      while(queues.next(worker, job))
+      {
+        std::shared_ptr<Output> output = std::make_shared<Output>(job.output);
+        std::vector<unsigned char> buffer;
+        long long bytes;
+
+        try
+        {
+          XMPWrap xmp(job.module, options.panning, options.rate, options.sequence);
+
+          writer.open(output);
+          if(options.wav)
+          {
+            buffer = wav_header(options, unknown_size);
+          }
+
+          buffer.reserve(chunk_size);
+          bytes = render(xmp, options, [&](const void *data, std::size_t size) {
+            const unsigned char *p = static_cast<const unsigned char *>(data);
+
+            buffer.insert(buffer.end(), p, p + size);
+            if(buffer.size() >= chunk_size)
+            {
+              writer.write(output, std::move(buffer));
+              buffer = std::vector<unsigned char>();
+              buffer.reserve(chunk_size);
+            }
+
+            return output->ok.load();
+          });
+        }
+        catch(const XMPWrap::InvalidFile &)
+        {
+          std::fprintf(stderr, "xmprender: %s: not a playable module (or no such sequence)\n", job.module.c_str());
+          failed++;
+          continue;
+        }
+
+        if(!buffer.empty())
+        {
+          writer.write(output, std::move(buffer));
+        }
+
+        std::vector<unsigned char> header;
+        if(options.wav && bytes >= 0 && bytes < unknown_size - 36)
+        {
+          header = wav_header(options, bytes);
+        }
+        writer.close(output, std::move(header));
+
+        if(bytes >= 0)
+        {
+          audio_bytes += bytes;
+        }
+
+        std::lock_guard<std::mutex> lock(written_mutex);
+        written.push_back(std::make_pair(job.module, output));
+      }
+    });
+
+    writer.drain();
+
+    for(const auto &w : written)
+    {
+      if(!w.second->ok)
+      {
+        std::fprintf(stderr, "xmprender: %s: error writing %s\n", w.first.c_str(), w.second->filename.c_str());
+        failed++;
+      }
+    }
+  }
+
+  double seconds = timer.nsecsElapsed() / 1e9;
+  double audio_seconds = audio_bytes.load() / double(options.rate * 2 * (options.to_float ? 4 : 2));
+
+  std::printf("threads=%d files=%zu failed=%d audio_seconds=%.3f seconds=%.3f realtime_factor=%.2f\n",
+              threads, modules.size(), failed.load(), audio_seconds, seconds, audio_seconds / seconds);
+  std::fflush(stdout);
+
+  return failed;
+}
@@ -0,0 +1,145 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <QtEndian>
+#include <QtGlobal>
+
+#include "render.h"
+#include "sampleconvert.h"
+#include "xmpwrap.h"
+
+static void put16(std::vector<unsigned char> &out, int value)
+{
+  out.push_back(value & 0xff);
+  out.push_back((value >> 8) & 0xff);
+}
+
+static void put32(std::vector<unsigned char> &out, std::uint32_t value)
+{
+  put16(out, value & 0xffff);
+  put16(out, (value >> 16) & 0xffff);
+}
+
+std::vector<unsigned char> wav_header(const RenderOptions &options, std::uint32_t data_size)
+{
+  std::vector<unsigned char> header;
+  int bytes_per_sample = options.to_float ? 4 : 2;
+
+  header.insert(header.end(), { 'R', 'I', 'F', 'F' });
+  put32(header, data_size == unknown_size ? data_size : data_size + 36);
+  header.insert(header.end(), { 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' });
+  put32(header, 16);
+  put16(header, options.to_float ? 3 : 1);      /* IEEE float or PCM */
+  put16(header, 2);
+  put32(header, options.rate);
+  put32(header, options.rate * 2 * bytes_per_sample);
+  put16(header, 2 * bytes_per_sample);
+  put16(header, bytes_per_sample * 8);
+  header.insert(header.end(), { 'd', 'a', 't', 'a' });
+  put32(header, data_size);
+
+  return header;
+}
+
+/* libxmp renders in native byte order. */
+template<typename T>
+static void to_little_endian(T *p, std::size_t samples)
+{
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+  for(std::size_t i = 0; i < samples; i++)
+  {
+    p[i] = qToLittleEndian(p[i]);
+  }
+#else
+  (void)p;
+  (void)samples;
+#endif
+}
+
+/* Render the module (or as much as options.seconds allows) to the sink,
+ * returning the number of bytes of audio rendered, or -1 if the sink
+ * gave up.  The sink sees little-endian stereo in the requested format.
+ */
+long long render(XMPWrap &xmp, const RenderOptions &options, const RenderSink &sink)
+{
+  long long limit = static_cast<long long>(options.seconds) * xmp.rate();
+  long long frames = 0;
+  long long written = 0;
+  std::vector<float> converted;
+  std::vector<std::uint16_t> swapped;
+
+  xmp.set_interpolator(options.interpolator);
+  xmp.set_stereo_separation(options.separation);
+
+  while(options.seconds == 0 || frames < limit)
+  {
+    XMPWrap::Frame frame = xmp.play_frame();
+    if(frame.n == 0)
+    {
+      break;
+    }
+
+    long long n = frame.n / xmp.frame_size();
+    if(options.seconds != 0 && frames + n > limit)
+    {
+      n = limit - frames;
+    }
+    frames += n;
+
+    std::size_t count = n * xmp.channels();
+    const void *data = frame.buf;
+    std::size_t size = count * sizeof(std::int16_t);
+
+    if(options.to_float)
+    {
+      converted.resize(count);
+      s16_to_float(converted.data(), static_cast<const std::int16_t *>(frame.buf), count);
+      to_little_endian(reinterpret_cast<std::uint32_t *>(converted.data()), count);
+      data = converted.data();
+      size = count * sizeof(float);
+    }
+    else if(Q_BYTE_ORDER == Q_BIG_ENDIAN)
+    {
+      const std::uint16_t *p = static_cast<const std::uint16_t *>(frame.buf);
+
+      swapped.assign(p, p + count);
+      to_little_endian(swapped.data(), count);
+      data = swapped.data();
+    }
+
+    if(!sink(data, size))
+    {
+      return -1;
+    }
+    written += size;
+  }
+
+  return written;
+}
@@ -0,0 +1,59 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef QMMP_XMP_RENDER_H
+#define QMMP_XMP_RENDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "xmpwrap.h"
+
+struct RenderOptions
+{
+  bool wav = false;
+  bool to_float = false;
+  int rate = XMPWrap::default_rate();
+  int interpolator = XMPWrap::default_interpolator();
+  int separation = XMPWrap::default_stereo_separation();
+  int panning = XMPWrap::default_panning_amplitude();
+  int sequence = 0;
+  int seconds = 0;
+};
+
+/* Receives rendered audio; returns false to stop rendering. */
+typedef std::function<bool(const void *, std::size_t)> RenderSink;
+
+/* A data size of unknown_size marks a WAV whose length isn't known. */
+const std::uint32_t unknown_size = 0xffffffff;
+std::vector<unsigned char> wav_header(const RenderOptions &, std::uint32_t data_size);
+
+long long render(XMPWrap &, const RenderOptions &, const RenderSink &);
+
+#endif
@@ -0,0 +1,284 @@
+/*-
+ * Copyright (c) 2015 Chris Spiegel
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Renders modules to raw PCM or WAV without Qmmp, using the plugin's own
+ * player (XMPWrap) and settings, as fast as the machine allows.
+ *
+ * usage: xmprender [options] module
+ *        xmprender [options] -d directory [-j threads] [-l list] module...
+ *
+ *   -o file         write to file instead of standard output
+ *   -f raw|wav      output container (default: wav if the output file
+ *                   name ends in .wav, raw otherwise; wav for -d)
+ *   -F s16|float    sample format (default: s16)
+ *   -r rate         sample rate (default: 44100)
+ *   -i interpolator nearest, linear or spline (default: spline)
+ *   -s separation   stereo separation, 0 to 100 (default: 70)
+ *   -p panning      panning amplitude, 0 to 100 (default: 50)
+ *   -n sequence     which sequence to render, from 1 (default: 1)
+ *   -t seconds      stop after this many seconds
+ *
+ * Batch mode, for rendering many modules in one go:
+ *
+ *   -d directory    render each module to a file in the directory
+ *   -j threads      how many modules to render at once (default: the
+ *                   number of CPUs)
+ *   -l list         also render the modules listed in this file, one per
+ *                   line ("-" for standard input)
+ *
+ * Output is always stereo and little-endian.  A WAV written to standard
+ * output has no sizes in its header, as it can't be rewritten at the end.
+ * Batch mode prints a summary, including the overall real-time factor.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "batch.h"
+#include "render.h"
+#include "xmpwrap.h"
+
+/* stdio's buffering, with a buffer large enough that writes are few. */
+static const std::size_t write_buffer_size = 1 << 20;
+
+static void usage()
+{
+  std::fprintf(stderr, "usage: xmprender [-o file] [-f raw|wav] [-F s16|float] [-r rate] [-i nearest|linear|spline]\n"
+                       "                 [-s separation] [-p panning] [-n sequence] [-t seconds] module\n"
+                       "       xmprender [options] -d directory [-j threads] [-l list] module...\n");
+  std::exit(1);
+}
+
+static bool ends_with(const std::string &s, const std::string &suffix)
+{
+  return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static bool read_list(const std::string &list, std::vector<std::string> &modules)
+{
+  std::ifstream file;
+  std::istream *in = &std::cin;
+  std::string line;
+
+  if(list != "-")
+  {
+    file.open(list);
+    if(!file)
+    {
+      return false;
+    }
+    in = &file;
+  }
+
+  while(std::getline(*in, line))
+  {
+    if(!line.empty())
+    {
+      modules.push_back(line);
+    }
+  }
+
+  return true;
+}
+
+static int render_one(const std::string &module, const std::string &output, const RenderOptions &options)
+{
+  std::unique_ptr<XMPWrap> xmp;
+  try
+  {
+    xmp = std::unique_ptr<XMPWrap>(new XMPWrap(module, options.panning, options.rate, options.sequence));
+  }
+  catch(const XMPWrap::InvalidFile &)
+  {
+    std::fprintf(stderr, "xmprender: %s: not a playable module (or no such sequence)\n", module.c_str());
+    return 1;
+  }
+
+  std::FILE *file = output.empty() ? stdout : std::fopen(output.c_str(), "wb");
+  if(file == nullptr)
+  {
+    std::fprintf(stderr, "xmprender: can't open %s: %s\n", output.c_str(), std::strerror(errno));
+    return 1;
+  }
+  std::setvbuf(file, nullptr, _IOFBF, write_buffer_size);
+
+  auto sink = [file](const void *data, std::size_t size) {
+    return std::fwrite(data, 1, size, file) == size;
+  };
+
+  bool ok = true;
+  if(options.wav)
+  {
+    std::vector<unsigned char> header = wav_header(options, unknown_size);
+    ok = sink(header.data(), header.size());
+  }
+
+  long long written = ok ? render(*xmp, options, sink) : -1;
+  ok = written >= 0;
+
+  /* Fill in the sizes if the output can be rewound. */
+  if(ok && options.wav && file != stdout && written < unknown_size - 36)
+  {
+    std::vector<unsigned char> header = wav_header(options, written);
+    ok = std::fseek(file, 0, SEEK_SET) == 0 && sink(header.data(), header.size());
+  }
+
+  if(std::fflush(file) != 0)
+  {
+    ok = false;
+  }
+  if(file != stdout && std::fclose(file) != 0)
+  {
+    ok = false;
+  }
+
+  if(!ok)
+  {
+    std::fprintf(stderr, "xmprender: error writing output\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  RenderOptions options;
+  std::string output;
+  std::string directory;
+  const char *format = nullptr;
+  int threads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::string> modules;
+
+  for(int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+
+    if(arg.size() == 2 && arg[0] == '-' && i + 1 < argc)
+    {
+      std::string value = argv[++i];
+
+      switch(arg[1])
+      {
+        case 'o':
+          output = value;
+          break;
+        case 'f':
+          format = argv[i];
+          break;
+        case 'F':
+          if(value != "s16" && value != "float") usage();
+          options.to_float = value == "float";
+          break;
+        case 'r':
+          options.rate = std::atoi(value.c_str());
+          break;
+        case 'i':
+          if(value == "nearest") options.interpolator = XMPWrap::interp_nearest;
+          else if(value == "linear") options.interpolator = XMPWrap::interp_linear;
+          else if(value == "spline") options.interpolator = XMPWrap::interp_spline;
+          else usage();
+          break;
+        case 's':
+          options.separation = std::atoi(value.c_str());
+          break;
+        case 'p':
+          options.panning = std::atoi(value.c_str());
+          break;
+        case 'n':
+          options.sequence = std::atoi(value.c_str()) - 1;
+          break;
+        case 't':
+          options.seconds = std::atoi(value.c_str());
+          break;
+        case 'd':
+          directory = value;
+          break;
+        case 'j':
+          threads = std::atoi(value.c_str());
+          break;
+        case 'l':
+          if(!read_list(value, modules))
+          {
+            std::fprintf(stderr, "xmprender: can't read %s\n", value.c_str());
+            return 1;
+          }
+          break;
+        default:
+          usage();
+      }
+    }
+    else if(arg[0] == '-')
+    {
+      usage();
+    }
+    else
+    {
+      modules.push_back(arg);
+    }
+  }
+
+  if(format != nullptr)
+  {
+    if(std::strcmp(format, "raw") != 0 && std::strcmp(format, "wav") != 0) usage();
+    options.wav = std::strcmp(format, "wav") == 0;
+  }
+  else
+  {
+    options.wav = !directory.empty() || ends_with(output, ".wav");
+  }
+
+  if(modules.empty() || !XMPWrap::is_valid_rate(options.rate) ||
+     !XMPWrap::is_valid_stereo_separation(options.separation) ||
+     !XMPWrap::is_valid_panning_amplitude(options.panning) ||
+     options.sequence < 0 || options.seconds < 0 || threads < 1)
+  {
+    usage();
+  }
+
+  if(!directory.empty())
+  {
+    if(!output.empty()) usage();
+    return render_batch(modules, options, directory, threads) == 0 ? 0 : 1;
+  }
+
+  if(modules.size() != 1)
+  {
+    usage();
+  }
+
+  return render_one(modules[0], output, options);
+}
@@ -0,0 +1,28 @@
+# Built from the plugin's own sources, but needs only QtCore and libxmp,
+# not Qmmp.
+
+QT      -= gui
+CONFIG  += console warn_on link_pkgconfig c++11 thread
+CONFIG  -= app_bundle
+
+TEMPLATE = app
+TARGET   = xmprender
+
+INCLUDEPATH += $$PWD/../..
+DEPENDPATH  += $$PWD/../..
+
+HEADERS += batch.h render.h
+SOURCES += xmprender.cpp \
+           batch.cpp \
+           render.cpp \
+           ../../contextpool.cpp \
+           ../../modulecache.cpp \
+           ../../sampleconvert.cpp \
+           ../../xmpwrap.cpp
+
+unix {
+  PKGCONFIG += libxmp
+
+  target.path = /usr/local/bin
+  INSTALLS += target
+}
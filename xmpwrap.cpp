@@ -25,52 +25,179 @@
  */
 
 #include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include <xmp.h>
 
+#include <QByteArray>
+#include <QFile>
+#include <QIODevice>
 #include <QObject>
+#include <QString>
 
+#include "contextpool.h"
+#include "modulecache.h"
 #include "xmpwrap.h"
 
-XMPWrap::XMPWrap(std::string filename, int panning_amplitude) : ctx(xmp_create_context())
+XMPWrap::XMPWrap(std::string filename, int panning_amplitude, int rate, int sequence, bool fill_cache) :
+  ctx(ContextPool::acquire()),
+  rate_(is_valid_rate(rate) ? rate : default_rate()),
+  sequence_(sequence)
 {
-  struct xmp_module_info module_info;
+  set_panning_amplitude(panning_amplitude);
+
+  if(load_file(filename, fill_cache) != 0)
+  {
+    ContextPool::release(ctx);
+    throw InvalidFile();
+  }
+
+  start();
+}
+
+XMPWrap::XMPWrap(const Memory &memory, int panning_amplitude, int rate, int sequence) :
+  ctx(ContextPool::acquire()),
+  rate_(is_valid_rate(rate) ? rate : default_rate()),
+  sequence_(sequence)
+{
+  set_panning_amplitude(panning_amplitude);
+
+  if(xmp_load_module_from_memory(ctx, const_cast<void *>(memory.data), memory.size) != 0)
+  {
+    ContextPool::release(ctx);
+    throw InvalidFile();
+  }
 
+  start();
+}
+
+void XMPWrap::set_panning_amplitude(int panning_amplitude)
+{
   if(is_valid_panning_amplitude(panning_amplitude))
   {
     xmp_set_player(ctx, XMP_PLAYER_DEFPAN, panning_amplitude);
   }
+}
+
+/* Load the file from memory, which avoids libxmp's many small buffered
+ * reads: from the module cache if the file is there (or, if asked to
+ * fill the cache, it has room for the file), otherwise from a mapping of
+ * it.  If that doesn't work out, let libxmp load the file by name:
+ * besides covering files that can't be read or mapped, that's the only
+ * way libxmp will unpack compressed modules.
+ */
+int XMPWrap::load_file(const std::string &filename, bool fill_cache)
+{
+  QString name = QString::fromStdString(filename);
+  ModuleCache &cache = ModuleCache::instance();
+  QByteArray data = fill_cache ? cache.get(name) : cache.find(name);
 
-  if(xmp_load_module(ctx, const_cast<char *>(filename.c_str())) != 0)
+  if(!data.isNull())
   {
-    xmp_free_context(ctx);
-    throw InvalidFile();
+    if(xmp_load_module_from_memory(ctx, const_cast<char *>(data.constData()), data.size()) == 0)
+    {
+      return 0;
+    }
+
+    /* No use keeping what libxmp can't load from memory. */
+    ModuleCache::instance().remove(name);
+  }
+  else
+  {
+    QFile file(name);
+
+    if(file.open(QIODevice::ReadOnly) && file.size() > 0)
+    {
+      uchar *mapped = file.map(0, file.size());
+      if(mapped != nullptr)
+      {
+        int status = xmp_load_module_from_memory(ctx, mapped, file.size());
+
+        file.unmap(mapped);
+
+        if(status == 0)
+        {
+          return 0;
+        }
+      }
+    }
   }
 
-  if(xmp_start_player(ctx, rate(), 0) != 0)
+  return xmp_load_module(ctx, const_cast<char *>(filename.c_str()));
+}
+
+void XMPWrap::start()
+{
+  struct xmp_module_info module_info;
+
+  if(xmp_start_player(ctx, rate_, 0) != 0)
   {
-    xmp_release_module(ctx);
-    xmp_free_context(ctx);
+    ContextPool::release(ctx);
     throw InvalidFile();
   };
 
+  /* A recycled context keeps the mixer settings of its last module. */
+  set_interpolator(default_interpolator());
+  set_stereo_separation(default_stereo_separation());
+
+  xmp_get_module_info(ctx, &module_info);
+
+  if(sequence_ < 0 || sequence_ >= module_info.num_sequences)
+  {
+    ContextPool::release(ctx);
+    throw InvalidFile();
+  }
+
+  entry_point_ = module_info.seq_data[sequence_].entry_point;
+  duration_ = module_info.seq_data[sequence_].duration;
+  channel_count_ = module_info.mod->chn;
+
+  for(int i = 0; i < channel_count_; i++)
+  {
+    module_muted_[i] = (module_info.mod->xxc[i].flg & XMP_CHANNEL_MUTE) != 0;
+    apply_mute(i);
+  }
+
+  if(sequence_ != 0)
+  {
+    xmp_set_position(ctx, entry_point_);
+  }
+}
+
+/* Everything there is to know about the module, for the playlist and the
+ * details dialog.  This is built on request rather than when the module
+ * is loaded, since a decoder has no use for names and comments, and
+ * copying them (a module can have 255 instruments and more samples)
+ * would be wasted on every track played.
+ */
+ModuleInfo XMPWrap::info()
+{
+  struct xmp_module_info module_info;
+  ModuleInfo info;
+
   xmp_get_module_info(ctx, &module_info);
   struct xmp_module *mod = module_info.mod;
 
-  duration_ = module_info.seq_data[0].duration;
-  title_ = mod->name;
-  format_ = mod->type;
-  pattern_count_ = mod->pat;
-  track_count_ = mod->trk;
-  channel_count_ = mod->chn;
-  instrument_count_ = mod->ins;
-  sample_count_ = mod->smp;
-  initial_speed_ = mod->spd;
-  initial_bpm_ = mod->bpm;
-  length_ = mod->len;
+  for(int i = 0; i < module_info.num_sequences; i++)
+  {
+    info.sequences.push_back(ModuleInfo::Sequence(module_info.seq_data[i].entry_point, module_info.seq_data[i].duration));
+  }
+
+  info.duration = module_info.seq_data[0].duration;
+  info.title = mod->name;
+  info.format = mod->type;
+  info.pattern_count = mod->pat;
+  info.track_count = mod->trk;
+  info.channel_count = mod->chn;
+  info.instrument_count = mod->ins;
+  info.sample_count = mod->smp;
+  info.initial_speed = mod->spd;
+  info.initial_bpm = mod->bpm;
+  info.length = mod->len;
 
   for(int i = 0; i < mod->chn; i++)
   {
@@ -79,15 +206,15 @@ XMPWrap::XMPWrap(std::string filename, int panning_amplitude) : ctx(xmp_create_c
     {
       if(c.flg & XMP_CHANNEL_SYNTH)
       {
-        channel_pan_.push_back('S');
+        info.channel_pan.push_back('S');
       }
       else if(c.flg & XMP_CHANNEL_MUTE)
       {
-        channel_pan_.push_back('-');
+        info.channel_pan.push_back('-');
       }
       else
       {
-        channel_pan_.push_back('?');
+        info.channel_pan.push_back('?');
       }
     }
     else
@@ -96,31 +223,54 @@ XMPWrap::XMPWrap(std::string filename, int panning_amplitude) : ctx(xmp_create_c
       /* Channel pan is documented as "0x80 is center", but XMP reports
        * only the top 4 bits, so follow its lead.
        */
-      channel_pan_.push_back(hexdigit[(c.pan >> 4) & 0x0f]);
+      info.channel_pan.push_back(hexdigit[(c.pan >> 4) & 0x0f]);
     }
   }
 
   for(int i = 0; i < mod->ins; i++)
   {
-    instruments_.push_back(mod->xxi[i].name);
+    info.instruments.push_back(mod->xxi[i].name);
   }
 
   for(int i = 0; i < mod->smp; i++)
   {
-    samples_.push_back(mod->xxs[i].name);
+    info.samples.push_back(mod->xxs[i].name);
   }
 
   if(module_info.comment != nullptr)
   {
-    comment_ = module_info.comment;
+    info.comment = module_info.comment;
+  }
+
+  return info;
+}
+
+void XMPWrap::apply_mute(int channel)
+{
+  bool mute = module_muted_[channel] || muted_[channel];
+
+  xmp_channel_mute(ctx, channel, mute ? 1 : 0);
+}
+
+/* Mute (or, with the rest muted, solo) channels on the user's behalf. */
+void XMPWrap::set_muted_channels(const ChannelSet &channels)
+{
+  ChannelSet changed = channels ^ muted_;
+
+  muted_ = channels;
+
+  for(int i = 0; i < channel_count_; i++)
+  {
+    if(changed[i])
+    {
+      apply_mute(i);
+    }
   }
 }
 
 XMPWrap::~XMPWrap()
 {
-  xmp_end_player(ctx);
-  xmp_release_module(ctx);
-  xmp_free_context(ctx);
+  ContextPool::release(ctx);
 }
 
 bool XMPWrap::can_play(std::string filename)
@@ -128,6 +278,27 @@ bool XMPWrap::can_play(std::string filename)
   return xmp_test_module(const_cast<char *>(filename.c_str()), nullptr) == 0;
 }
 
+/* Fill in the title and format from a parse of the module header only,
+ * without loading samples, scanning the duration or starting the player.
+ * Other fields are left untouched.  Note that the format is libxmp's
+ * name for the loader, which is less specific than what a full load
+ * reports.
+ */
+bool XMPWrap::probe(std::string filename, ModuleInfo &info)
+{
+  struct xmp_test_info test_info;
+
+  if(xmp_test_module(const_cast<char *>(filename.c_str()), &test_info) != 0)
+  {
+    return false;
+  }
+
+  info.title = test_info.name;
+  info.format = test_info.type;
+
+  return true;
+}
+
 std::vector<XMPWrap::Interpolator> XMPWrap::get_interpolators()
 {
   std::vector<Interpolator> interpolators = {
@@ -139,13 +310,21 @@ std::vector<XMPWrap::Interpolator> XMPWrap::get_interpolators()
   return interpolators;
 }
 
+/* This is called whenever an interpolator is applied, so it checks the
+ * values directly rather than building the (translated) list returned by
+ * get_interpolators().
+ */
 bool XMPWrap::is_valid_interpolator(int interpolator_value)
 {
-  std::vector<Interpolator> interpolators = get_interpolators();
-
-  return std::any_of(interpolators.begin(), interpolators.end(),
-                     [&interpolator_value]
-                     (const Interpolator &interpolator) { return interpolator.value == interpolator_value; });
+  switch(interpolator_value)
+  {
+    case interp_nearest:
+    case interp_linear:
+    case interp_spline:
+      return true;
+    default:
+      return false;
+  }
 }
 
 int XMPWrap::default_interpolator()
@@ -189,7 +368,52 @@ int XMPWrap::default_panning_amplitude()
   return 50;
 }
 
+std::vector<int> XMPWrap::get_block_sizes()
+{
+  return { 64, 128, 256, 512, 1024 };
+}
+
+bool XMPWrap::is_valid_block_size(int size)
+{
+  std::vector<int> sizes = get_block_sizes();
+
+  return size == 0 || std::find(sizes.begin(), sizes.end(), size) != sizes.end();
+}
+
+std::vector<int> XMPWrap::get_rates()
+{
+  return { 22050, 32000, 44100, 48000 };
+}
+
+/* libxmp refuses to mix at rates much above 48kHz. */
+bool XMPWrap::is_valid_rate(int rate)
+{
+  return rate >= 8000 && rate <= 48000;
+}
+
+int XMPWrap::default_rate()
+{
+  return 44100;
+}
+
 XMPWrap::Frame XMPWrap::play_frame()
+{
+  if(pending_.n != 0)
+  {
+    Frame frame = pending_;
+    pending_ = Frame(0, nullptr);
+    return frame;
+  }
+
+  return render_frame();
+}
+
+/* Render a tick, keeping track of the position in sample frames.  While
+ * new ground is being covered, the start of each row is added to the
+ * seek index.  xmp_set_row() first appeared in libxmp 4.5; without it,
+ * only the starts of patterns are useful.
+ */
+XMPWrap::Frame XMPWrap::render_frame()
 {
   struct xmp_frame_info fi;
 
@@ -203,21 +427,233 @@ XMPWrap::Frame XMPWrap::play_frame()
     return Frame(0, nullptr);
   }
 
+#if XMP_VERCODE >= 0x040500
+  bool indexable = fi.frame == 0;
+#else
+  bool indexable = fi.frame == 0 && fi.row == 0;
+#endif
+
+  /* The index only grows while rendering carries on from its end: after
+   * a jump past it (see seek()), positions are only approximate.
+   */
+  bool contiguous = position_ == indexed_until_;
+
+  if(contiguous && indexable)
+  {
+    index_.push_back(Row(fi.pos, fi.row, fi.speed, fi.bpm, position_));
+  }
+
+  position_ += fi.buffer_size / frame_size();
+  if(contiguous)
+  {
+    indexed_until_ = position_;
+  }
+
   return Frame(fi.buffer_size, fi.buffer);
 }
 
+/* Fill the caller's buffer from as many ticks as it takes, returning the
+ * number of bytes written: less than the size only at the end of the
+ * module.  Whatever is left of the last tick is kept for the next call.
+ */
+int XMPWrap::play_frame(void *buf, int size)
+{
+  int filled = 0;
+
+  while(filled < size)
+  {
+    if(pending_.n == 0)
+    {
+      pending_ = render_frame();
+      if(pending_.n == 0)
+      {
+        break;
+      }
+    }
+
+    int n = std::min(size - filled, pending_.n);
+    std::memcpy(static_cast<char *>(buf) + filled, pending_.buf, n);
+    filled += n;
+    pending_ = Frame(pending_.n - n, static_cast<const char *>(pending_.buf) + n);
+  }
+
+  return filled;
+}
+
+/* Seek to the sample frame for the requested time (in milliseconds).
+ * The seek index records where each row started the first time through,
+ * so playback can jump to the last row starting at or before the target
+ * and render from there, throwing away whatever comes before the target.
+ *
+ * Past the end of the index, playback first jumps to the start of the
+ * order containing the target, using the start times libxmp worked out
+ * when it scanned the module, so that at most a pattern is rendered and
+ * thrown away rather than everything up to the target.  Those times are
+ * in whole milliseconds, so such a seek is only accurate to within a
+ * millisecond, and the index isn't extended from there.  If the order
+ * starts within the index anyway, the index is used instead.
+ * bench/seekcheck checks where these seeks land.
+ */
 void XMPWrap::seek(int pos)
 {
-  struct xmp_frame_info fi[2];
+  long long target = static_cast<long long>(pos) * rate_ / 1000;
+  bool moved = false;
 
-  xmp_get_frame_info(ctx, &fi[0]);
-  xmp_seek_time(ctx, pos);
-  xmp_get_frame_info(ctx, &fi[1]);
+  pending_ = Frame(0, nullptr);
 
-  /* XMP seeks on a pattern-by-pattern basis, approximating the
-   * requested seek time.  If the pattern is so long that the seek
-   * time would stay on the same pattern, jump to the next pattern.
-   * Make an exception, though, if the desired seek time is zero.
-   */
-  if(pos > 0 && fi[0].pos == fi[1].pos) xmp_set_position(ctx, fi[1].pos + 1);
+  if(target > indexed_until_)
+  {
+    long long start = seek_order(pos);
+
+    if(start > indexed_until_)
+    {
+      position_ = start + pending_.n / frame_size();
+      if(position_ > target)
+      {
+        int skip = static_cast<int>(std::max(target - start, 0LL)) * frame_size();
+        pending_ = Frame(pending_.n - skip, static_cast<const char *>(pending_.buf) + skip);
+      }
+      else
+      {
+        pending_ = Frame(0, nullptr);
+        discard(target);
+      }
+      return;
+    }
+
+    /* Even if libxmp couldn't say where it went, it may have moved. */
+    pending_ = Frame(0, nullptr);
+    moved = true;
+  }
+
+  const Row *row = find_row(target);
+
+  if(row == nullptr)
+  {
+    if(moved || target < position_)
+    {
+      xmp_set_position(ctx, entry_point_);
+      position_ = 0;
+    }
+  }
+  else if(moved || target < position_ || position_ < row->frame)
+  {
+    xmp_set_position(ctx, row->pos);
+#if XMP_VERCODE >= 0x040500
+    if(row->row != 0)
+    {
+      xmp_set_row(ctx, row->row);
+    }
+#endif
+    position_ = row->frame;
+  }
+
+  discard(target);
+}
+
+/* Jump to the start of the order (in the current sequence) containing
+ * the specified time, returning the frame at which it starts, or -1 if
+ * libxmp couldn't jump.  libxmp only makes the jump on the next call to
+ * xmp_play_frame(), which sets the time to the start of the order and
+ * then adds on the length of the tick it plays, so the first tick is
+ * rendered here and its length (in microseconds) taken off again; order
+ * start times are whole milliseconds, so rounding up undoes the
+ * truncation of fi.time.  The tick is left in pending_.
+ */
+long long XMPWrap::seek_order(int pos)
+{
+  struct xmp_frame_info fi;
+
+  if(xmp_seek_time(ctx, pos) < 0 || xmp_play_frame(ctx) != 0)
+  {
+    return -1;
+  }
+  xmp_get_frame_info(ctx, &fi);
+
+  long long time = std::max((static_cast<long long>(fi.time) * 1000 - fi.frame_time + 999) / 1000, 0LL);
+
+  pending_ = Frame(fi.buffer_size, fi.buffer);
+
+  return time * rate_ / 1000;
+}
+
+/* Find the row to jump to when seeking to the specified frame.
+ * xmp_set_position() restores the tempo in effect at the start of a
+ * pattern, but nothing restores a tempo change partway through one, so
+ * in that case go back to the start of the pattern instead.
+ */
+const XMPWrap::Row *XMPWrap::find_row(long long target)
+{
+  auto it = std::upper_bound(index_.begin(), index_.end(), target,
+                             [](long long frame, const Row &row) { return frame < row.frame; });
+
+  if(it == index_.begin())
+  {
+    return nullptr;
+  }
+
+  std::size_t i = it - index_.begin() - 1;
+  const Row *row = &index_[i];
+
+  for(std::size_t j = i + 1; j-- > 0 && index_[j].pos == row->pos; )
+  {
+    if(index_[j].row == 0)
+    {
+      if(index_[j].speed != row->speed || index_[j].bpm != row->bpm)
+      {
+        row = &index_[j];
+      }
+      break;
+    }
+  }
+
+  return row;
+}
+
+/* Render and throw away audio up to the target frame.  Most of it is
+ * rendered with the cheapest interpolator, switching back to the real
+ * one shortly before the target; the part of the last frame that lies
+ * past the target is kept for the next call to play_frame().
+ */
+void XMPWrap::discard(long long target)
+{
+  int interpolator = xmp_get_player(ctx, XMP_PLAYER_INTERP);
+  bool fast = false;
+  long long last = 0;
+
+  while(position_ < target)
+  {
+    bool near = target - position_ <= 2 * last;
+    long long start = position_;
+
+    if(!near && !fast)
+    {
+      xmp_set_player(ctx, XMP_PLAYER_INTERP, interp_nearest);
+      fast = true;
+    }
+    else if(near && fast)
+    {
+      xmp_set_player(ctx, XMP_PLAYER_INTERP, interpolator);
+      fast = false;
+    }
+
+    Frame frame = render_frame();
+    if(frame.n == 0)
+    {
+      break;
+    }
+
+    last = position_ - start;
+
+    if(position_ > target)
+    {
+      int skip = static_cast<int>(target - start) * frame_size();
+      pending_ = Frame(frame.n - skip, static_cast<const char *>(frame.buf) + skip);
+    }
+  }
+
+  if(fast)
+  {
+    xmp_set_player(ctx, XMP_PLAYER_INTERP, interpolator);
+  }
 }
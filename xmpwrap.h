@@ -27,12 +27,15 @@
 #ifndef QMMP_XMP_XMPWRAP_H
 #define QMMP_XMP_XMPWRAP_H
 
+#include <bitset>
 #include <exception>
 #include <string>
 #include <vector>
 
 #include <xmp.h>
 
+#include "moduleinfo.h"
+
 class XMPWrap
 {
   public:
@@ -43,11 +46,26 @@ class XMPWrap
       int value;
     };
 
+    /* A rendered frame.  The buffer belongs to libxmp, which mixes into
+     * memory of its own; it remains valid until the next call to
+     * play_frame() or seek().
+     */
     struct Frame
     {
-      Frame(int n, void *buf) : n(n), buf(buf) { }
+      Frame(int n, const void *buf) : n(n), buf(buf) { }
       int n;
-      void *buf;
+      const void *buf;
+    };
+
+    /* A module held in memory which belongs to the caller.  libxmp copies
+     * whatever it keeps, so the memory need only be valid while the
+     * constructor runs.
+     */
+    struct Memory
+    {
+      Memory(const void *data, long size) : data(data), size(size) { }
+      const void *data;
+      long size;
     };
 
     class InvalidFile : public std::exception
@@ -56,16 +74,25 @@ class XMPWrap
         InvalidFile() : std::exception() { }
     };
 
+    /* Channels are numbered from 0. */
+    typedef std::bitset<XMP_MAX_CHANNELS> ChannelSet;
+
     static const int interp_nearest = XMP_INTERP_NEAREST;
     static const int interp_linear = XMP_INTERP_LINEAR;
     static const int interp_spline = XMP_INTERP_SPLINE;
 
-    explicit XMPWrap(std::string, int = -1);
+    /* Loading a file only adds it to the module cache if asked to, as
+     * when it's about to be played; otherwise the cache is used if the
+     * file is already there.
+     */
+    explicit XMPWrap(std::string, int = -1, int = default_rate(), int = 0, bool = false);
+    XMPWrap(const Memory &, int, int, int = 0);
     XMPWrap(const XMPWrap &) = delete;
     XMPWrap &operator=(const XMPWrap &) = delete;
     ~XMPWrap();
 
     static bool can_play(std::string);
+    static bool probe(std::string, ModuleInfo &);
 
     static std::vector<Interpolator> get_interpolators();
     static bool is_valid_interpolator(int);
@@ -79,45 +106,69 @@ class XMPWrap
     static bool is_valid_panning_amplitude(int);
     static int default_panning_amplitude();
 
+    void set_muted_channels(const ChannelSet &);
+    ChannelSet muted_channels() { return muted_; }
+
+    /* Block sizes, the most audio a decoder read returns, are in sample
+     * frames; 0 means no limit.
+     */
+    static std::vector<int> get_block_sizes();
+    static bool is_valid_block_size(int);
+    int buffered() { return pending_.n / frame_size(); }
+
+    static std::vector<int> get_rates();
+    static bool is_valid_rate(int);
+    static int default_rate();
+
     Frame play_frame();
+    int play_frame(void *, int);
     void seek(int pos);
 
-    int rate() { return 44100; }
+    int rate() { return rate_; }
     int channels() { return 2; }
     int depth() { return 16; }
+    int frame_size() { return channels() * depth() / 8; }
     int duration() { return duration_; }
-    const std::string &title() { return title_; }
-    const std::string &format() { return format_; }
-    int pattern_count() { return pattern_count_; }
-    int track_count() { return track_count_; }
+    int sequence() { return sequence_; }
     int channel_count() { return channel_count_; }
-    const std::vector<char> &channel_pan() { return channel_pan_; }
-    int instrument_count() { return instrument_count_; }
-    int sample_count() { return sample_count_; }
-    int initial_speed() { return initial_speed_; }
-    int initial_bpm() { return initial_bpm_; }
-    int length() { return length_; }
-    const std::vector<std::string> &instruments() { return instruments_; }
-    const std::vector<std::string> &samples() { return samples_; }
-    const std::string &comment() { return comment_; }
+    ModuleInfo info();
 
   private:
+    struct Row
+    {
+      Row(int pos, int row, int speed, int bpm, long long frame) : pos(pos), row(row), speed(speed), bpm(bpm), frame(frame) { }
+      int pos;
+      int row;
+      int speed;
+      int bpm;
+      long long frame;
+    };
+
+    void set_panning_amplitude(int);
+    int load_file(const std::string &, bool);
+    void start();
+    Frame render_frame();
+    long long seek_order(int);
+    const Row *find_row(long long);
+    void discard(long long);
+    void apply_mute(int);
+
     xmp_context ctx;
-    int duration_;
-    std::string title_;
-    std::string format_;
-    int pattern_count_;
-    int track_count_;
-    int channel_count_;
-    std::vector<char> channel_pan_;
-    int instrument_count_;
-    int sample_count_;
-    int initial_speed_;
-    int initial_bpm_;
-    int length_;
-    std::vector<std::string> instruments_;
-    std::vector<std::string> samples_;
-    std::string comment_;
+    int rate_;
+    int sequence_;
+    int entry_point_ = 0;
+    int duration_ = 0;
+    int channel_count_ = 0;
+
+    /* Positions are in sample frames from the start of the sequence. */
+    long long position_ = 0;
+    long long indexed_until_ = 0;
+    std::vector<Row> index_;
+    Frame pending_ = Frame(0, nullptr);
+
+    /* A channel is muted if either the module or the user says so. */
+    ChannelSet module_muted_;
+    ChannelSet muted_;
 };
 
 #endif